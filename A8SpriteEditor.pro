@@ -1,4 +1,4 @@
-QT       += core gui
+QT       += core gui concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -9,19 +9,37 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    autosavejournal.cpp \
+    brush.cpp \
     canvas.cpp \
     canvassizing.cpp \
+    floodfill.cpp \
     frame.cpp \
     framemanager.cpp \
+    framepreviewmodel.cpp \
     main.cpp \
-    mainwindow.cpp
+    mainwindow.cpp \
+    paintbatch.cpp \
+    rasterizer.cpp \
+    selection.cpp \
+    spritefile.cpp \
+    symmetry.cpp
 
 HEADERS += \
+    autosavejournal.h \
+    brush.h \
     canvas.h \
     canvassizing.h \
+    floodfill.h \
     frame.h \
     framemanager.h \
-    mainwindow.h
+    framepreviewmodel.h \
+    mainwindow.h \
+    paintbatch.h \
+    rasterizer.h \
+    selection.h \
+    spritefile.h \
+    symmetry.h
 
 FORMS += \
     canvas.ui \
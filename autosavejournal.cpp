@@ -0,0 +1,395 @@
+/*
+    Authors: Zhuyi Bu, Zhenzhi Liu, Justin Melore, Maxwell Rodgers, Duke Nguyen, Minh Khoa Ngo
+    Github usernames: 1144761429, 0doxes0, JustinMelore, maxdotr, duke7012, Mkhoa161
+    Date: November 16th, 2024
+    Class: CS3505, Fall 2024
+    Assignment - A8: Sprite Editor Implementation
+
+    The cpp file for the AutosaveJournal class.
+*/
+
+#include "autosavejournal.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtConcurrent>
+#include <cstring>
+
+const char AutosaveJournal::MAGIC[4] = {'S', 'P', 'R', 'J'};
+
+AutosaveJournal::AutosaveJournal(const QString& filePath) : filePath(filePath), lockFile(filePath + ".lock") {
+    // Only a lock whose process is gone counts as stale, however long the other instance keeps running
+    lockFile.setStaleLockTime(0);
+}
+
+bool AutosaveJournal::acquire() {
+    if (lockFile.isLocked()) {
+        return true;
+    }
+    QDir().mkpath(QFileInfo(filePath).absolutePath());
+    return lockFile.tryLock(0);
+}
+
+bool AutosaveJournal::isAcquired() const {
+    return lockFile.isLocked();
+}
+
+bool AutosaveJournal::exists() const {
+    return QFile::exists(filePath);
+}
+
+void AutosaveJournal::markFrameChanged(const Frame* frame) {
+    changedFrames.insert(frame);
+}
+
+void AutosaveJournal::markLayoutChanged() {
+    isLayoutChanged = true;
+}
+
+void AutosaveJournal::markPaletteChanged(const QList<QRgb>& newPalette) {
+    palette = newPalette;
+    isPaletteChanged = true;
+}
+
+void AutosaveJournal::forgetFrame(const Frame* frame) {
+    frameIds.remove(frame);
+    changedFrames.remove(frame);
+}
+
+bool AutosaveJournal::hasChanges() const {
+    return isLayoutChanged || isPaletteChanged || !changedFrames.isEmpty();
+}
+
+bool AutosaveJournal::needsCheckpoint() const {
+    return !hasCheckpoint || journalSize - checkpointSize > qMax(checkpointSize, MIN_COMPACTION_SIZE);
+}
+
+AutosaveJournal::Append AutosaveJournal::takeAppend(int sideLength, const std::vector<Frame*>& frames) {
+    Append append;
+    append.sideLength = sideLength;
+
+    if (isLayoutChanged) {
+        append.hasLayout = true;
+        append.layout.reserve(frames.size());
+        for (const Frame* frame : frames) {
+            append.layout.push_back(frameId(frame));
+        }
+    }
+
+    if (isPaletteChanged) {
+        append.hasPalette = true;
+        append.palette = palette;
+    }
+
+    QSet<const Frame*> pendingFrames = changedFrames;
+    for (const Frame* frame : frames) {
+        if (pendingFrames.remove(frame)) {
+            append.ids.push_back(frameId(frame));
+            append.frames.push_back(frame->snapshot());
+        }
+    }
+
+    changedFrames.clear();
+    isLayoutChanged = false;
+    isPaletteChanged = false;
+    return append;
+}
+
+qint64 AutosaveJournal::writeAppend(const QString& filePath, const Append& append) {
+    QByteArray out;
+
+    if (append.hasLayout) {
+        QByteArray payload;
+        QDataStream stream(&payload, QIODevice::WriteOnly);
+        stream.setByteOrder(QDataStream::LittleEndian);
+        writeLayout(stream, append.sideLength, append.layout);
+        appendRecord(out, LAYOUT, payload);
+    }
+
+    if (append.hasPalette) {
+        appendPalette(out, append.palette);
+    }
+
+    if (!append.frames.empty()) {
+        std::vector<SpriteFile::EncodedFrame> images =
+            QtConcurrent::blockingMapped<std::vector<SpriteFile::EncodedFrame>>(append.frames,
+                                                                                Frame::encodeJournalSnapshot);
+
+        QByteArray payload;
+        QDataStream stream(&payload, QIODevice::WriteOnly);
+        stream.setByteOrder(QDataStream::LittleEndian);
+        writeImages(stream, append.ids, images);
+        appendRecord(out, FRAMES, payload);
+    }
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append) || file.write(out) != out.size()) {
+        return -1;
+    }
+    return out.size();
+}
+
+void AutosaveJournal::appendWritten(qint64 size) {
+    if (size < 0) {
+        // The changes the append held are no longer marked, so only a full checkpoint records them again
+        hasCheckpoint = false;
+        return;
+    }
+    journalSize += size;
+}
+
+AutosaveJournal::Checkpoint AutosaveJournal::takeCheckpoint(int sideLength, const std::vector<Frame*>& frames) {
+    Checkpoint checkpoint;
+    checkpoint.sideLength = sideLength;
+
+    QSet<const Frame*> capturedFrames;
+    for (const Frame* frame : frames) {
+        quint32 id = frameId(frame);
+        checkpoint.layout.push_back(id);
+
+        // A frame appearing more than once in the layout is only stored once
+        if (!capturedFrames.contains(frame)) {
+            capturedFrames.insert(frame);
+            checkpoint.ids.push_back(id);
+            checkpoint.frames.push_back(frame->snapshot());
+        }
+    }
+
+    checkpoint.palette = palette;
+
+    changedFrames.clear();
+    isLayoutChanged = false;
+    isPaletteChanged = false;
+    return checkpoint;
+}
+
+qint64 AutosaveJournal::writeCheckpoint(const QString& filePath, const Checkpoint& checkpoint) {
+    std::vector<SpriteFile::EncodedFrame> images =
+        QtConcurrent::blockingMapped<std::vector<SpriteFile::EncodedFrame>>(checkpoint.frames,
+                                                                            Frame::encodeJournalSnapshot);
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    writeLayout(stream, checkpoint.sideLength, checkpoint.layout);
+    writeImages(stream, checkpoint.ids, images);
+
+    QByteArray out;
+    QDataStream header(&out, QIODevice::WriteOnly);
+    header.setByteOrder(QDataStream::LittleEndian);
+    header.writeRawData(MAGIC, sizeof(MAGIC));
+    header << quint16(VERSION);
+    appendRecord(out, CHECKPOINT, payload);
+    if (!checkpoint.palette.isEmpty()) {
+        appendPalette(out, checkpoint.palette);
+    }
+
+    QDir().mkpath(QFileInfo(filePath).absolutePath());
+
+    // The old journal stays intact until the new one is complete
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(out) != out.size() || !file.commit()) {
+        return -1;
+    }
+
+    return out.size();
+}
+
+void AutosaveJournal::checkpointWritten(qint64 size) {
+    if (size < 0) {
+        // Everything recorded since the checkpoint was taken is lost with it, so the next one is full again
+        hasCheckpoint = false;
+        return;
+    }
+
+    hasCheckpoint = true;
+    checkpointSize = size;
+    journalSize = size;
+}
+
+bool AutosaveJournal::recover(int& sideLength, std::vector<SpriteFile::EncodedFrame>& frames,
+                              QList<QRgb>& palette) const {
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QByteArray data = file.readAll();
+    if (data.size() < FILE_HEADER_SIZE || std::memcmp(data.constData(), MAGIC, sizeof(MAGIC)) != 0) {
+        return false;
+    }
+
+    bool hasRecoveredCheckpoint = false;
+    std::vector<quint32> layout;
+    QHash<quint32, SpriteFile::EncodedFrame> images;
+
+    auto readLayout = [&](QDataStream& stream) {
+        quint32 side, count;
+        stream >> side >> count;
+        sideLength = int(side);
+        layout.assign(count, 0);
+        for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+            stream >> layout[i];
+        }
+    };
+
+    auto readPalette = [&](QDataStream& stream) {
+        quint32 count;
+        stream >> count;
+        palette.clear();
+        for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+            quint32 color;
+            stream >> color;
+            palette.append(color);
+        }
+    };
+
+    auto readImages = [&](QDataStream& stream, const QByteArray& payload) {
+        quint32 count;
+        stream >> count;
+        for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+            quint32 id, size;
+            SpriteFile::EncodedFrame image;
+            stream >> id >> image.encoding >> size;
+
+            // mid copies the blob, so the recovered frames own their data
+            qint64 offset = stream.device()->pos();
+            image.blob = payload.mid(offset, size);
+            stream.skipRawData(size);
+            images.insert(id, image);
+        }
+    };
+
+    qint64 position = FILE_HEADER_SIZE;
+    while (data.size() - position >= RECORD_HEADER_SIZE) {
+        QDataStream header(data.mid(position, RECORD_HEADER_SIZE));
+        header.setByteOrder(QDataStream::LittleEndian);
+        quint8 type;
+        quint32 size;
+        quint16 checksum;
+        header >> type >> size >> checksum;
+
+        // A crash in the middle of an append leaves a torn record at the end, everything before it is still good
+        if (data.size() - position - RECORD_HEADER_SIZE < size) {
+            break;
+        }
+        QByteArray payload = data.mid(position + RECORD_HEADER_SIZE, size);
+        if (qChecksum(payload) != checksum) {
+            break;
+        }
+        position += RECORD_HEADER_SIZE + size;
+
+        QDataStream stream(payload);
+        stream.setByteOrder(QDataStream::LittleEndian);
+        switch (type) {
+            case CHECKPOINT:
+                images.clear();
+                palette.clear();
+                readLayout(stream);
+                readImages(stream, payload);
+                hasRecoveredCheckpoint = true;
+                break;
+            case LAYOUT:
+                readLayout(stream);
+                break;
+            case FRAMES:
+                readImages(stream, payload);
+                break;
+            case PALETTE:
+                readPalette(stream);
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (!hasRecoveredCheckpoint || sideLength <= 0) {
+        return false;
+    }
+
+    // An id appearing more than once in the layout is a linked frame
+    frames.clear();
+    QHash<quint32, int> firstIndices;
+    for (quint32 id : layout) {
+        if (firstIndices.contains(id)) {
+            frames.push_back(SpriteFile::linkTo(firstIndices.value(id)));
+        } else {
+            firstIndices.insert(id, frames.size());
+            frames.push_back(images.value(id));
+        }
+    }
+    return true;
+}
+
+void AutosaveJournal::requestCheckpoint() {
+    hasCheckpoint = false;
+}
+
+void AutosaveJournal::reset() {
+    frameIds.clear();
+    nextFrameId = 0;
+    changedFrames.clear();
+    isLayoutChanged = false;
+    palette.clear();
+    isPaletteChanged = false;
+    hasCheckpoint = false;
+    checkpointSize = 0;
+    journalSize = 0;
+}
+
+void AutosaveJournal::discard() {
+    reset();
+    if (isAcquired()) {
+        QFile::remove(filePath);
+    }
+}
+
+QString AutosaveJournal::getFilePath() const {
+    return filePath;
+}
+
+quint32 AutosaveJournal::frameId(const Frame* frame) {
+    auto it = frameIds.find(frame);
+    if (it == frameIds.end()) {
+        it = frameIds.insert(frame, nextFrameId++);
+    }
+    return it.value();
+}
+
+void AutosaveJournal::appendRecord(QByteArray& out, RecordType type, const QByteArray& payload) {
+    QByteArray header;
+    QDataStream stream(&header, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream << quint8(type) << quint32(payload.size()) << quint16(qChecksum(payload));
+
+    out += header;
+    out += payload;
+}
+
+void AutosaveJournal::writeLayout(QDataStream& stream, int sideLength, const std::vector<quint32>& layout) {
+    stream << quint32(sideLength) << quint32(layout.size());
+    for (quint32 id : layout) {
+        stream << id;
+    }
+}
+
+void AutosaveJournal::appendPalette(QByteArray& out, const QList<QRgb>& palette) {
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream << quint32(palette.size());
+    for (QRgb color : palette) {
+        stream << quint32(color);
+    }
+    appendRecord(out, PALETTE, payload);
+}
+
+void AutosaveJournal::writeImages(QDataStream& stream, const std::vector<quint32>& ids,
+                                  const std::vector<SpriteFile::EncodedFrame>& images) {
+    stream << quint32(images.size());
+    for (size_t i = 0; i < images.size(); i++) {
+        stream << ids[i] << images[i].encoding << quint32(images[i].blob.size());
+        stream.writeRawData(images[i].blob.constData(), images[i].blob.size());
+    }
+}
@@ -0,0 +1,208 @@
+/*
+    Authors: Zhuyi Bu, Zhenzhi Liu, Justin Melore, Maxwell Rodgers, Duke Nguyen, Minh Khoa Ngo
+    Github usernames: 1144761429, 0doxes0, JustinMelore, maxdotr, duke7012, Mkhoa161
+    Date: November 16th, 2024
+    Class: CS3505, Fall 2024
+    Assignment - A8: Sprite Editor Implementation
+
+    The AutosaveJournal class keeps an append-only record of the project so it can be recovered after a crash.
+    The journal starts with a checkpoint holding every frame. After that, each autosave only appends the frames
+    that changed since the previous one, plus the frame order when frames were added, removed or moved. Once the
+    appended records outgrow the checkpoint, the journal is compacted by writing a fresh checkpoint in its place.
+    What a checkpoint or an append records is captured as copy-on-write snapshots, so the frames are encoded and
+    written on a worker thread.
+
+    A lock file next to the journal keeps a second instance of the editor from recovering, overwriting or deleting
+    the journal of one that is still running.
+
+    Frames are identified by an id the journal hands out, so the frame order survives insertions and removals.
+    Indexed frames are stored as palette indices, so changing a color of the palette only appends the palette.
+
+    Layout (all integers little-endian):
+        header  "SPRJ" | quint16 version
+        record  quint8 type | quint32 payload size | quint16 payload checksum | payload
+    Record payloads:
+        CHECKPOINT  layout | images       (replaces everything recorded before it)
+        LAYOUT      layout
+        FRAMES      images
+        PALETTE     quint32 colorCount | colorCount x quint32 color   (empty when the project is not indexed)
+    where layout is quint32 sideLength | quint32 frameCount | frameCount x quint32 id
+    and images is quint32 imageCount | imageCount x (quint32 id | quint8 encoding | quint32 size | blob).
+*/
+
+#ifndef AUTOSAVEJOURNAL_H
+#define AUTOSAVEJOURNAL_H
+
+#include <QDataStream>
+#include <QHash>
+#include <QList>
+#include <QLockFile>
+#include <QSet>
+#include <QString>
+#include <vector>
+#include "frame.h"
+
+class AutosaveJournal
+{
+public:
+    /// \brief Everything needed to write a checkpoint, captured on the GUI thread and written on a worker thread.
+    struct Checkpoint {
+        int sideLength = 0;
+        std::vector<quint32> layout;
+        std::vector<quint32> ids;
+        std::vector<Frame::Snapshot> frames;
+        QList<QRgb> palette;
+    };
+
+    /// \brief Everything an append records, captured on the GUI thread and encoded and written on a worker thread.
+    struct Append {
+        int sideLength = 0;
+        bool hasLayout = false;
+        std::vector<quint32> layout;
+        bool hasPalette = false;
+        QList<QRgb> palette;
+        std::vector<quint32> ids;
+        std::vector<Frame::Snapshot> frames;
+    };
+
+    /// \brief Constructor for the journal. Nothing is written until the first checkpoint.
+    /// \param filePath The path of the journal file.
+    explicit AutosaveJournal(const QString& filePath);
+
+    /// \brief acquire Take the lock file next to the journal. A lock left behind by a crashed instance is stale and
+    /// gets taken over.
+    /// \return False if another running instance holds the journal.
+    bool acquire();
+
+    /// \brief isAcquired Check if this instance holds the journal, see acquire.
+    bool isAcquired() const;
+
+    /// \brief exists Check if a journal was left behind, which means the editor did not exit cleanly.
+    bool exists() const;
+
+    /// \brief markFrameChanged Record that the pixels of a frame changed, so the next append includes it.
+    /// \param frame The changed frame.
+    void markFrameChanged(const Frame* frame);
+
+    /// \brief markLayoutChanged Record that frames were added, removed, moved or resized.
+    void markLayoutChanged();
+
+    /// \brief markPaletteChanged Record a new palette, so the next append includes it.
+    /// \param palette The colors indexed frames point to, empty when the project is not indexed.
+    void markPaletteChanged(const QList<QRgb>& palette);
+
+    /// \brief forgetFrame Drop a frame that is about to be deleted, so its id is not handed to a new frame
+    /// that happens to get the same address.
+    /// \param frame The deleted frame.
+    void forgetFrame(const Frame* frame);
+
+    /// \brief hasChanges Check if anything changed since the last append or checkpoint.
+    bool hasChanges() const;
+
+    /// \brief needsCheckpoint Check if the next autosave has to write a full checkpoint: either there is none
+    /// yet, or the appended records have outgrown the last one.
+    bool needsCheckpoint() const;
+
+    /// \brief takeAppend Capture what changed since the last autosave and treat it as recorded. Only the changed
+    /// frames are captured, so the cost follows the edit rather than the project.
+    /// \param sideLength The side length of the frames.
+    /// \param frames The frames of the project, in order.
+    /// \return The append, to be written by writeAppend.
+    Append takeAppend(int sideLength, const std::vector<Frame*>& frames);
+
+    /// \brief writeAppend Encode the frames of an append in parallel and append its records to the journal.
+    /// Safe to call from a worker thread.
+    /// \param filePath The path of the journal file.
+    /// \param append The append to write.
+    /// \return The amount of bytes appended, or -1 if the journal could not be written.
+    static qint64 writeAppend(const QString& filePath, const Append& append);
+
+    /// \brief appendWritten Record the outcome of writeAppend. After a failed append the next autosave writes a
+    /// full checkpoint, since the changes it held are lost.
+    /// \param size The size returned by writeAppend.
+    void appendWritten(qint64 size);
+
+    /// \brief takeCheckpoint Capture every frame for a checkpoint and treat all changes as recorded.
+    /// \param sideLength The side length of the frames.
+    /// \param frames The frames of the project, in order.
+    /// \return The checkpoint, to be written by writeCheckpoint.
+    Checkpoint takeCheckpoint(int sideLength, const std::vector<Frame*>& frames);
+
+    /// \brief writeCheckpoint Atomically replace the journal with a single checkpoint record. The frames are
+    /// encoded in parallel. Safe to call from a worker thread.
+    /// \param filePath The path of the journal file.
+    /// \param checkpoint The checkpoint to write.
+    /// \return The size of the new journal, or -1 if it could not be written.
+    static qint64 writeCheckpoint(const QString& filePath, const Checkpoint& checkpoint);
+
+    /// \brief checkpointWritten Record the outcome of writeCheckpoint, so following appends go after it.
+    /// \param size The size returned by writeCheckpoint.
+    void checkpointWritten(qint64 size);
+
+    /// \brief recover Replay the journal, stopping at the first torn or corrupt record.
+    /// \param sideLength Receives the side length of the recovered frames.
+    /// \param frames Receives the encoded pixels of the recovered frames, in order. A frame whose pixels were
+    /// never recorded gets a null blob, and a frame linked to an earlier one gets a link, see SpriteFile::linkTo.
+    /// Indexed frames get an INDEXED blob, see SpriteFile::decodeIndices.
+    /// \param palette Receives the palette the INDEXED blobs point to, empty if the project was not indexed.
+    /// \return False if the journal holds no complete checkpoint.
+    bool recover(int& sideLength, std::vector<SpriteFile::EncodedFrame>& frames, QList<QRgb>& palette) const;
+
+    /// \brief requestCheckpoint Make the next autosave write a full checkpoint, e.g. after a whole new project
+    /// was loaded. The current journal stays on disk until the checkpoint replaces it.
+    void requestCheckpoint();
+
+    /// \brief reset Forget every frame, the palette and every change, keeping the journal file until the next checkpoint
+    /// replaces it.
+    void reset();
+
+    /// \brief discard Reset the journal and delete its file, unless another instance holds it.
+    void discard();
+
+    /// \brief getFilePath Returns the path of the journal file.
+    QString getFilePath() const;
+
+private:
+    enum RecordType : quint8 {
+        CHECKPOINT = 1,
+        LAYOUT = 2,
+        FRAMES = 3,
+        PALETTE = 4
+    };
+
+    static const char MAGIC[4];
+    static const quint16 VERSION = 1;
+    static const int FILE_HEADER_SIZE = 6;
+    static const int RECORD_HEADER_SIZE = 7;
+    static const qint64 MIN_COMPACTION_SIZE = 1024 * 1024;
+
+    QString filePath;
+    QLockFile lockFile;
+    QHash<const Frame*, quint32> frameIds;
+    quint32 nextFrameId = 0;
+    QSet<const Frame*> changedFrames;
+    bool isLayoutChanged = false;
+    QList<QRgb> palette;
+    bool isPaletteChanged = false;
+    bool hasCheckpoint = false;
+    qint64 checkpointSize = 0;
+    qint64 journalSize = 0;
+
+    /// \brief frameId Returns the id of a frame, handing out a new one the first time a frame is seen.
+    quint32 frameId(const Frame* frame);
+
+    /// \brief appendRecord Frame a payload as a record of the journal.
+    static void appendRecord(QByteArray& out, RecordType type, const QByteArray& payload);
+
+    /// \brief writeLayout Write the side length and the frame ids in order.
+    static void writeLayout(QDataStream& stream, int sideLength, const std::vector<quint32>& layout);
+
+    /// \brief appendPalette Frame a palette as a PALETTE record.
+    static void appendPalette(QByteArray& out, const QList<QRgb>& palette);
+
+    /// \brief writeImages Write the encoded pixels of frames, each tagged with its id.
+    static void writeImages(QDataStream& stream, const std::vector<quint32>& ids,
+                            const std::vector<SpriteFile::EncodedFrame>& images);
+};
+
+#endif // AUTOSAVEJOURNAL_H
@@ -0,0 +1,115 @@
+/*
+    Authors: Zhuyi Bu, Zhenzhi Liu, Justin Melore, Maxwell Rodgers, Duke Nguyen, Minh Khoa Ngo
+    Github usernames: 1144761429, 0doxes0, JustinMelore, maxdotr, duke7012, Mkhoa161
+    Date: November 23rd, 2024
+    Class: CS3505, Fall 2024
+    Assignment - A8: Sprite Editor Implementation
+
+    The cpp file for the Brush class.
+*/
+
+#include "brush.h"
+#include <cmath>
+
+Brush::Brush() {
+    updateStamp();
+}
+
+void Brush::setSize(int newSize) {
+    size = newSize < 1 ? 1 : (newSize > MAX_SIZE ? MAX_SIZE : newSize);
+    updateStamp();
+}
+
+void Brush::setShape(Shape newShape) {
+    if (newShape == CUSTOM && customMask.isNull()) {
+        return;
+    }
+    shape = newShape;
+    updateStamp();
+}
+
+bool Brush::setCustomMask(const QImage& mask) {
+    if (mask.isNull() || mask.width() > MAX_SIZE || mask.height() > MAX_SIZE) {
+        return false;
+    }
+
+    QImage argb = mask.convertToFormat(QImage::Format_ARGB32);
+    bool hasOpaquePixel = false;
+    for (int y = 0; y < argb.height() && !hasOpaquePixel; y++) {
+        const QRgb* row = reinterpret_cast<const QRgb*>(argb.constScanLine(y));
+        for (int x = 0; x < argb.width(); x++) {
+            if (qAlpha(row[x]) >= 128) {
+                hasOpaquePixel = true;
+                break;
+            }
+        }
+    }
+    if (!hasOpaquePixel) {
+        return false;
+    }
+
+    customMask = argb;
+    shape = CUSTOM;
+    updateStamp();
+    return true;
+}
+
+bool Brush::isSinglePixel() const {
+    return stamp.size() == 1 && stamp[0].dy == 0 && stamp[0].left == 0 && stamp[0].right == 0;
+}
+
+void Brush::stampSpan(int y, int left, int right, Rasterizer& target) const {
+    // Sliding a run of the stamp along the row covers the run widened by the row's length
+    for (const StampRun& run : stamp) {
+        target.addSpan(y + run.dy, left + run.left, right + run.right);
+    }
+}
+
+void Brush::updateStamp() {
+    stamp.clear();
+
+    if (shape == CUSTOM) {
+        int top = -(customMask.height() / 2);
+        int leftEdge = -(customMask.width() / 2);
+        for (int y = 0; y < customMask.height(); y++) {
+            const QRgb* row = reinterpret_cast<const QRgb*>(customMask.constScanLine(y));
+            int x = 0;
+            while (x < customMask.width()) {
+                if (qAlpha(row[x]) < 128) {
+                    x++;
+                    continue;
+                }
+                int start = x;
+                while (x < customMask.width() && qAlpha(row[x]) >= 128) {
+                    x++;
+                }
+                stamp.push_back(StampRun{top + y, leftEdge + start, leftEdge + x - 1});
+            }
+        }
+        return;
+    }
+
+    // Even sizes have one more pixel left of and above the center than right of and below it
+    int first = -(size / 2);
+    int last = first + size - 1;
+    if (shape == SQUARE) {
+        for (int dy = first; dy <= last; dy++) {
+            stamp.push_back(StampRun{dy, first, last});
+        }
+        return;
+    }
+
+    // A pixel is in the round tip if its center is inside a circle slightly smaller than the tip, which rounds
+    // off the corners of small tips too
+    double middle = (first + last) / 2.0;
+    double radius = size / 2.0 - 0.1;
+    for (int dy = first; dy <= last; dy++) {
+        double offsetY = dy - middle;
+        double halfWidth = std::sqrt(std::max(0.0, radius * radius - offsetY * offsetY));
+        int left = int(std::ceil(middle - halfWidth));
+        int right = int(std::floor(middle + halfWidth));
+        if (left <= right) {
+            stamp.push_back(StampRun{dy, left, right});
+        }
+    }
+}
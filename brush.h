@@ -0,0 +1,78 @@
+/*
+    Authors: Zhuyi Bu, Zhenzhi Liu, Justin Melore, Maxwell Rodgers, Duke Nguyen, Minh Khoa Ngo
+    Github usernames: 1144761429, 0doxes0, JustinMelore, maxdotr, duke7012, Mkhoa161
+    Date: November 23rd, 2024
+    Class: CS3505, Fall 2024
+    Assignment - A8: Sprite Editor Implementation
+
+    The Brush class holds the tip of the brush and the eraser: a square or round tip of a given size, or a custom
+    tip taken from an image. The tip is turned into a stamp mask once, whenever it changes, as runs of pixels
+    relative to the center of the tip. Stamping the tip along a row of the stroke then takes one span per row of
+    the stamp, however long the row is.
+*/
+
+#ifndef BRUSH_H
+#define BRUSH_H
+
+#include "rasterizer.h"
+#include <QImage>
+#include <vector>
+
+class Brush
+{
+public:
+    enum Shape {
+        SQUARE = 0,
+        ROUND = 1,
+        CUSTOM = 2
+    };
+
+    static const int MAX_SIZE = 128;
+
+    /// \brief Constructor for the brush, which starts as a single pixel.
+    Brush();
+
+    /// \brief setSize Set the width of square and round tips.
+    /// \param newSize The width in pixels, from 1 to MAX_SIZE.
+    void setSize(int newSize);
+
+    /// \brief setShape Switch between the square, round and custom tip. The custom tip needs a mask first, see
+    /// setCustomMask.
+    void setShape(Shape newShape);
+
+    /// \brief setCustomMask Take a custom tip from an image and switch to it. The pixels that are at least half
+    /// opaque make up the tip, centered on the middle of the image.
+    /// \param mask The image, at most MAX_SIZE pixels wide and high.
+    /// \return False if the image is too large or has no opaque pixel, in which case the tip stays as it was.
+    bool setCustomMask(const QImage& mask);
+
+    /// \brief isSinglePixel Check if the tip is one pixel, so stamping it changes nothing.
+    bool isSinglePixel() const;
+
+    /// \brief stampSpan Stamp the tip centered on every pixel of a row.
+    /// \param y The row.
+    /// \param left The first column.
+    /// \param right The last column.
+    /// \param target Receives the stamped pixels.
+    void stampSpan(int y, int left, int right, Rasterizer& target) const;
+
+private:
+    /// \brief A run of pixels of the stamp, relative to the center of the tip.
+    struct StampRun {
+        int dy;
+        int left;
+        int right;
+    };
+
+    Shape shape = SQUARE;
+    int size = 1;
+    QImage customMask;
+
+    // The stamp of the current tip, row by row
+    std::vector<StampRun> stamp;
+
+    /// \brief updateStamp Build the stamp again after the tip changed.
+    void updateStamp();
+};
+
+#endif // BRUSH_H
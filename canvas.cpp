@@ -10,7 +10,13 @@
 #include "canvas.h"
 #include "ui_canvas.h"
 #include <QMouseEvent>
+#include <QPaintEvent>
+#include <QWheelEvent>
 #include <QPainter>
+#include <QtAlgorithms>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <vector>
 
 using std::vector;
@@ -20,14 +26,15 @@ Canvas::Canvas(QWidget *parent)
     , ui(new Ui::Canvas) {
     ui->setupUi(this);
 
-    pixelSize = DEFAULT_PIXEL_SIZE;
     selectedColor = DEFAULT_COLOR;
     currentMode = DEFAULT_MODE;
 
-    isMirrorMode = false;
+    isPressingMouse = false;
     isShapeMode = false;
 
-    backgroundPixmap = QPixmap(size());
+    strokeTimer.setSingleShot(true);
+    strokeTimer.setInterval(STROKE_INTERVAL);
+    connect(&strokeTimer, &QTimer::timeout, this, &Canvas::flushStroke);
 }
 
 Canvas::~Canvas() {
@@ -37,6 +44,11 @@ Canvas::~Canvas() {
 void Canvas::onToolSelected(Mode mode) {
     currentMode = mode;
 
+    // The selection only lives while a selection tool is picked
+    if (!isSelectionMode()) {
+        anchorSelection();
+    }
+
     switch(currentMode){
         case BRUSH:
             isShapeMode = false;
@@ -44,13 +56,112 @@ void Canvas::onToolSelected(Mode mode) {
         case ERASER:
             isShapeMode = false;
             break;
+        case BUCKET:
+            isShapeMode = false;
+            break;
+        case SELECT_RECT:
+            isShapeMode = false;
+            break;
+        case SELECT_LASSO:
+            isShapeMode = false;
+            break;
         default:
             isShapeMode = true;
     }
 }
 
 void Canvas::onMirrorModeSet(bool enabled) {
-    isMirrorMode = enabled;
+    symmetry.setMirroredLeftRight(enabled);
+    update();
+}
+
+void Canvas::onMirrorTopBottomSet(bool enabled) {
+    symmetry.setMirroredTopBottom(enabled);
+    update();
+}
+
+void Canvas::onRotationalSymmetrySet(int count) {
+    symmetry.setRotations(count);
+    update();
+}
+
+void Canvas::onSymmetryCenterReset() {
+    symmetry.setSideLength(sideLength);
+    update();
+}
+
+void Canvas::onBrushSizeSet(int size) {
+    brush.setSize(size);
+}
+
+void Canvas::onBrushShapeSet(int shape) {
+    brush.setShape(static_cast<Brush::Shape>(shape));
+}
+
+bool Canvas::onCustomBrushSet(const QImage& mask) {
+    return brush.setCustomMask(mask);
+}
+
+void Canvas::onFillDiagonalSet(bool enabled) {
+    fillOptions.isDiagonal = enabled;
+}
+
+void Canvas::onFillToleranceSet(int tolerance) {
+    fillOptions.tolerance = tolerance;
+}
+
+void Canvas::onFillAllMatchingSet(bool enabled) {
+    fillOptions.isGlobal = enabled;
+}
+
+void Canvas::onSelectAll() {
+    anchorSelection();
+    selection.setRect(QRect(0, 0, sideLength, sideLength), sideLength);
+    updateSelectionArea(selection.getRect());
+}
+
+void Canvas::onDeselect() {
+    anchorSelection();
+}
+
+void Canvas::onCopy() {
+    if (selection.isEmpty() || !hasFrame()) {
+        return;
+    }
+
+    // The images are shared, not copied, until one of them is written to
+    clipboardPixels = selection.isFloating() ? selection.getPixels() : selection.copyPixels(*foregroundImage);
+    clipboardMask = selection.getMask();
+    clipboardPosition = selection.getRect().topLeft();
+}
+
+void Canvas::onCut() {
+    onCopy();
+    onDeleteSelection();
+}
+
+void Canvas::onPaste() {
+    if (clipboardMask.isNull()) {
+        return;
+    }
+    anchorSelection();
+    selection.setFloating(clipboardPixels, clipboardMask, clipboardPosition);
+    updateSelectionArea(selection.getRect());
+}
+
+void Canvas::onDeleteSelection() {
+    if (selection.isEmpty()) {
+        return;
+    }
+
+    // Floating pixels are not part of the frame yet, so dropping them is enough
+    QRect selectionRect = selection.getRect();
+    if (!selection.isFloating()) {
+        eraseSelection();
+    }
+    selection.clear();
+    isDraggingSelection = false;
+    updateSelectionArea(selectionRect);
 }
 
 void Canvas::onCurrentColorSet(int r, int g, int b, int a) {
@@ -58,42 +169,395 @@ void Canvas::onCurrentColorSet(int r, int g, int b, int a) {
 }
 
 void Canvas::onSelectedFrameChanged(Frame *newSelectedFrame) {
-    foregroundPixmap = &(newSelectedFrame->pixmap);
+    foregroundImage = &(newSelectedFrame->getImage());
 
-    paintedPixels.clear();
-    paintedColors.clear();
+    shapeRaster.clear();
+    paintRaster.clear();
+    strokeCoverage.clear();
+    clearOverlay();
 
-    repaint();
+    mipLevels.clear();
+    resetDisplayCache();
+    update();
 }
 
 void Canvas::onSideLengthChanged(int newSideLength) {
     sideLength = newSideLength;
-    pixelSize = uiMinSide / sideLength;
-    paintCheckerBoard(pixelSize * sideLength);
-    repaint();
+    paintRaster.setClipRect(QRect(0, 0, sideLength, sideLength));
+    symmetry.setSideLength(sideLength);
+    shapeRaster.clear();
+    paintRaster.clear();
+    strokeCoverage.clear();
+    clearOverlay();
+    selection.clear();
+    isDraggingSelection = false;
+    lassoPath.clear();
+    selectionPreview = QRect();
+    hasMousePixelPos = false;
+    mipLevels.clear();
+    resetDisplayCache();
+    isFitToView = true;
+    fitToView();
+    update();
 }
 
-void Canvas::paintEvent(QPaintEvent *event) {
-    Q_UNUSED(event);
+void Canvas::onFrameRegionChanged(const QRect& pixelRect) {
+    updateMipLevels(pixelRect);
+
+    // Only the cells of the shown level above the change are composited again
+    QRect changed = pixelRect.intersected(QRect(0, 0, sideLength, sideLength));
+    if (!changed.isEmpty() && !displayCells.isEmpty() && displayHasFrame == hasFrame()) {
+        refreshDisplayCache(QRect(QPoint(changed.left() >> displayLevel, changed.top() >> displayLevel),
+                                  QPoint(changed.right() >> displayLevel, changed.bottom() >> displayLevel)));
+    }
 
+    // Updates are merged into a single paint event, so a stroke touching many cells still repaints once
+    update(widgetRect(pixelRect));
+}
+
+void Canvas::onZoomIn() {
+    zoomAt(QRectF(rect()).center(), steppedZoom(true));
+}
+
+void Canvas::onZoomOut() {
+    zoomAt(QRectF(rect()).center(), steppedZoom(false));
+}
+
+void Canvas::onZoomToFit() {
+    isFitToView = true;
+    fitToView();
+    update();
+}
+
+void Canvas::paintEvent(QPaintEvent *event) {
     QPainter painter(this);
-    painter.drawPixmap(0, 0, backgroundPixmap);
+    painter.fillRect(event->rect(), palette().color(QPalette::Window));
+    if (sideLength <= 0) {
+        return;
+    }
+
+    // Zoomed out, a cell of a mip level stands for a block of canvas pixels, so there are never many more
+    // cells to composite than screen pixels, whatever the side length
+    int level = mipLevelFor(zoom);
+    if (hasFrame()) {
+        ensureMipLevel(level);
+    }
+    double cellSize = zoom * (1 << level);
+    int checkerCells = std::max(1, int(std::ceil(MIN_CHECKER_SIZE / cellSize)));
+    if (level != displayLevel || checkerCells != displayCheckerCells || hasFrame() != displayHasFrame) {
+        resetDisplayCache();
+        displayLevel = level;
+        displayCheckerCells = checkerCells;
+        displayHasFrame = hasFrame();
+    }
+
+    // The cache is only composited again when the view leaves it, otherwise painting is a scaled copy of it
+    QRect visibleCells = cellsUnder(rect(), level);
+    if (visibleCells.isEmpty()) {
+        return;
+    }
+    if (!displayCells.contains(visibleCells)) {
+        rebuildDisplayCache(visibleCells);
+    }
+
+    // A shape being dragged replaces the pixels under it, like it will once it is committed, and so do the pixels of
+    // a floating selection
+    updateDisplayLayer(overlayLayer, overlayRect, overlayMask, nullptr, qPremultiply(overlayColor.rgba()));
+    if (selection.isFloating()) {
+        updateDisplayLayer(floatingLayer, selection.getRect(), selection.getMask(), &selection.getPixels(), 0);
+    } else {
+        floatingLayer = DisplayLayer();
+    }
 
-    if (foregroundPixmap != nullptr) {
-        int scaledResolution = foregroundPixmap->height() * pixelSize;
-        painter.drawPixmap(0, 0, foregroundPixmap->scaled(scaledResolution, scaledResolution));
+    QRect area = cellsUnder(event->rect(), level);
+    drawCells(painter, displayCache, displayCells, area, cellSize);
+    drawCells(painter, overlayLayer.image, overlayLayer.cells, area, cellSize);
+    drawCells(painter, floatingLayer.image, floatingLayer.cells, area, cellSize);
+
+    // The mirror axes, or a mark on the center for rotations alone
+    if (symmetry.isEnabled()) {
+        QPointF center = pan + symmetry.getCenter() * zoom;
+        double extent = sideLength * zoom;
+        painter.setPen(QPen(SYMMETRY_GUIDE_COLOR, 0));
+        if (symmetry.isMirroredLeftRight()) {
+            painter.drawLine(QPointF(center.x(), pan.y()), QPointF(center.x(), pan.y() + extent));
+        }
+        if (symmetry.isMirroredTopBottom()) {
+            painter.drawLine(QPointF(pan.x(), center.y()), QPointF(pan.x() + extent, center.y()));
+        }
+        if (symmetry.getRotations() > 1) {
+            painter.drawEllipse(center, SYMMETRY_CENTER_RADIUS, SYMMETRY_CENTER_RADIUS);
+        }
+    }
+
+    // The outline of the selection, or of the rectangle or lasso being dragged out
+    QPainterPath outline = selectionPreviewPath();
+    if (!selection.isEmpty()) {
+        outline.addPath(selection.getOutline().translated(selection.getRect().topLeft()));
+    }
+    if (!outline.isEmpty()) {
+        painter.translate(pan);
+        painter.scale(zoom, zoom);
+        painter.setBrush(Qt::NoBrush);
+        painter.setPen(QPen(SELECTION_LIGHT_COLOR, 0));
+        painter.drawPath(outline);
+        painter.setPen(QPen(SELECTION_DARK_COLOR, 0, Qt::DashLine));
+        painter.drawPath(outline);
     }
 }
 
-QPoint Canvas::mirrorPixel(QPoint pixelPosition) {
-    int newPosition = canvasSize / pixelSize - pixelPosition.x() - 1;
-    return QPoint(newPosition, pixelPosition.y());
+bool Canvas::hasFrame() const {
+    // The side length changes on the canvas before the frames are resized, until then only the checkerboard shows
+    return foregroundImage != nullptr && foregroundImage->width() == sideLength;
 }
 
-void Canvas::paintPixels() {
-    // Make sure the canvas size is fixed for calculation in Mirror Mode
-    canvasSize = pixelSize * sideLength;
+QList<QRgb> Canvas::premultipliedColorTable() const {
+    QList<QRgb> colorTable;
+    if (hasFrame() && foregroundImage->format() == QImage::Format_Indexed8) {
+        for (QRgb color : foregroundImage->colorTable()) {
+            colorTable.append(qPremultiply(color));
+        }
+    }
+    return colorTable;
+}
+
+QRgb Canvas::cellColor(int level, int x, int y, const QList<QRgb>& colorTable) const {
+    if (!hasFrame()) {
+        return 0;
+    }
+    if (level > 0) {
+        return reinterpret_cast<const QRgb*>(mipLevels[level - 1].constScanLine(y))[x];
+    }
+    if (foregroundImage->format() == QImage::Format_Indexed8) {
+        return colorTable.value(foregroundImage->constScanLine(y)[x]);
+    }
+    return reinterpret_cast<const QRgb*>(foregroundImage->constScanLine(y))[x];
+}
+
+int Canvas::levelSideLength(int level) const {
+    return (sideLength + (1 << level) - 1) >> level;
+}
+
+int Canvas::mipLevelFor(double zoomFactor) const {
+    // The deepest level whose cells still cover at most one screen pixel
+    int level = 0;
+    while (zoomFactor * (2 << level) <= 1.0 && levelSideLength(level + 1) > 1) {
+        level++;
+    }
+    return level;
+}
+
+void Canvas::ensureMipLevel(int level) {
+    while (int(mipLevels.size()) < level) {
+        int newLevel = int(mipLevels.size()) + 1;
+        int side = levelSideLength(newLevel);
+        mipLevels.push_back(QImage(side, side, Frame::FORMAT));
+        downsample(newLevel, QRect(0, 0, side, side));
+    }
+}
+
+void Canvas::updateMipLevels(const QRect& pixelRect) {
+    QRect cells = pixelRect.intersected(QRect(0, 0, sideLength, sideLength));
+    if (cells.isEmpty() || !hasFrame()) {
+        return;
+    }
+
+    // Each level only needs the cells above the changed part of the level below
+    for (int level = 1; level <= int(mipLevels.size()); level++) {
+        cells = QRect(QPoint(cells.left() / 2, cells.top() / 2), QPoint(cells.right() / 2, cells.bottom() / 2));
+        downsample(level, cells);
+    }
+}
+
+void Canvas::downsample(int level, const QRect& cellRect) {
+    QList<QRgb> colorTable = level == 1 ? premultipliedColorTable() : QList<QRgb>();
+    int lastSourceCell = levelSideLength(level - 1) - 1;
+    QImage& target = mipLevels[level - 1];
+
+    for (int y = cellRect.top(); y <= cellRect.bottom(); y++) {
+        QRgb* out = reinterpret_cast<QRgb*>(target.scanLine(y));
+        int y0 = 2 * y;
+        int y1 = std::min(y0 + 1, lastSourceCell);
+        for (int x = cellRect.left(); x <= cellRect.right(); x++) {
+            int x0 = 2 * x;
+            int x1 = std::min(x0 + 1, lastSourceCell);
+
+            // Averaging premultiplied colors weighs every pixel by its alpha, as blending would
+            QRgb a = cellColor(level - 1, x0, y0, colorTable);
+            QRgb b = cellColor(level - 1, x1, y0, colorTable);
+            QRgb c = cellColor(level - 1, x0, y1, colorTable);
+            QRgb d = cellColor(level - 1, x1, y1, colorTable);
+            out[x] = qRgba((qRed(a) + qRed(b) + qRed(c) + qRed(d) + 2) / 4,
+                           (qGreen(a) + qGreen(b) + qGreen(c) + qGreen(d) + 2) / 4,
+                           (qBlue(a) + qBlue(b) + qBlue(c) + qBlue(d) + 2) / 4,
+                           (qAlpha(a) + qAlpha(b) + qAlpha(c) + qAlpha(d) + 2) / 4);
+        }
+    }
+}
+
+void Canvas::resetDisplayCache() {
+    displayCells = QRect();
+    overlayLayer = DisplayLayer();
+    floatingLayer = DisplayLayer();
+}
+
+void Canvas::rebuildDisplayCache(const QRect& visibleCells) {
+    // A margin of a quarter of the view on every side lets small pans reuse the cache
+    int cells = levelSideLength(displayLevel);
+    int marginX = visibleCells.width() / 4;
+    int marginY = visibleCells.height() / 4;
+    displayCells = visibleCells.adjusted(-marginX, -marginY, marginX, marginY).intersected(QRect(0, 0, cells, cells));
+    if (displayCache.size() != displayCells.size()) {
+        displayCache = QImage(displayCells.size(), Frame::FORMAT);
+    }
+    refreshDisplayCache(displayCells);
+}
+
+void Canvas::refreshDisplayCache(const QRect& cellRect) {
+    QRect cells = cellRect.intersected(displayCells);
+    if (cells.isEmpty()) {
+        return;
+    }
+
+    QList<QRgb> colorTable = premultipliedColorTable();
+    for (int y = cells.top(); y <= cells.bottom(); y++) {
+        QRgb* out = reinterpret_cast<QRgb*>(displayCache.scanLine(y - displayCells.top())) + (cells.left() - displayCells.left());
+        for (int x = cells.left(); x <= cells.right(); x++) {
+            *out++ = overChecker(cellColor(displayLevel, x, y, colorTable), x, y);
+        }
+    }
+}
+
+void Canvas::updateDisplayLayer(DisplayLayer& layer, const QRect& pixelRect, const QImage& mask, const QImage* pixels, QRgb color) {
+    qint64 pixelsKey = pixels != nullptr ? pixels->cacheKey() : 0;
+    if (layer.pixelRect == pixelRect && layer.maskKey == mask.cacheKey() && layer.pixelsKey == pixelsKey && layer.color == color) {
+        return;
+    }
+    layer.pixelRect = pixelRect;
+    layer.maskKey = mask.cacheKey();
+    layer.pixelsKey = pixelsKey;
+    layer.color = color;
+
+    // Zoomed out, a cell shows the layer if its top left canvas pixel is covered
+    QRect covered = pixelRect.intersected(QRect(0, 0, sideLength, sideLength));
+    int cellPixels = 1 << displayLevel;
+    layer.cells = covered.isEmpty() ? QRect()
+                                    : QRect(QPoint((covered.left() + cellPixels - 1) >> displayLevel, (covered.top() + cellPixels - 1) >> displayLevel),
+                                            QPoint(covered.right() >> displayLevel, covered.bottom() >> displayLevel));
+    if (layer.cells.isEmpty()) {
+        layer.image = QImage();
+        return;
+    }
+    if (layer.image.size() != layer.cells.size()) {
+        layer.image = QImage(layer.cells.size(), Frame::FORMAT);
+    }
+
+    for (int y = layer.cells.top(); y <= layer.cells.bottom(); y++) {
+        int pixelY = (y << displayLevel) - pixelRect.top();
+        const uchar* maskRow = mask.constScanLine(pixelY);
+        const QRgb* pixelRow = pixels != nullptr ? reinterpret_cast<const QRgb*>(pixels->constScanLine(pixelY)) : nullptr;
+        QRgb* out = reinterpret_cast<QRgb*>(layer.image.scanLine(y - layer.cells.top()));
+        for (int x = layer.cells.left(); x <= layer.cells.right(); x++) {
+            int pixelX = (x << displayLevel) - pixelRect.left();
+            if (maskRow[pixelX] == 0) {
+                *out++ = 0;
+            } else {
+                *out++ = overChecker(pixelRow != nullptr ? pixelRow[pixelX] : color, x, y);
+            }
+        }
+    }
+}
+
+QRgb Canvas::overChecker(QRgb pixel, int x, int y) const {
+    // Source-over onto the opaque checkerboard, with the pixel already premultiplied. The squares are gray, so a
+    // single rounded product, without dividing, serves every channel.
+    QRgb checker = (x / displayCheckerCells + y / displayCheckerCells) % 2 == 0 ? CHECKER_LIGHT : CHECKER_DARK;
+    uint shade = qRed(checker) * uint(255 - qAlpha(pixel)) + 128;
+    shade = (shade + (shade >> 8)) >> 8;
+    return qRgb(qRed(pixel) + shade, qGreen(pixel) + shade, qBlue(pixel) + shade);
+}
 
+void Canvas::drawCells(QPainter& painter, const QImage& image, const QRect& imageCells, const QRect& cellRect, double cellSize) const {
+    QRect cells = imageCells.intersected(cellRect);
+    if (cells.isEmpty()) {
+        return;
+    }
+
+    // Scaling without smoothing keeps every cell a sharp block
+    QRectF target(pan.x() + cells.left() * cellSize, pan.y() + cells.top() * cellSize, cells.width() * cellSize, cells.height() * cellSize);
+    painter.drawImage(target, image, QRectF(cells.translated(-imageCells.topLeft())));
+}
+
+QRect Canvas::cellsUnder(const QRect& area, int level) const {
+    double cellSize = zoom * (1 << level);
+    int cells = levelSideLength(level);
+    int left = std::max(0, int(std::floor((area.left() - pan.x()) / cellSize)));
+    int top = std::max(0, int(std::floor((area.top() - pan.y()) / cellSize)));
+    int right = std::min(cells - 1, int(std::floor((area.right() + 1 - pan.x()) / cellSize)));
+    int bottom = std::min(cells - 1, int(std::floor((area.bottom() + 1 - pan.y()) / cellSize)));
+    if (left > right || top > bottom) {
+        return QRect();
+    }
+    return QRect(QPoint(left, top), QPoint(right, bottom));
+}
+
+QRect Canvas::widgetRect(const QRect& pixelRect) const {
+    // A cell of the shown mip level covers a block of canvas pixels, all of it is repainted
+    int cellPixels = 1 << mipLevelFor(zoom);
+    int left = pixelRect.left() / cellPixels * cellPixels;
+    int top = pixelRect.top() / cellPixels * cellPixels;
+    int right = (pixelRect.right() / cellPixels + 1) * cellPixels;
+    int bottom = (pixelRect.bottom() / cellPixels + 1) * cellPixels;
+
+    QRectF area(pan.x() + left * zoom, pan.y() + top * zoom, (right - left) * zoom, (bottom - top) * zoom);
+    return area.toAlignedRect();
+}
+
+void Canvas::fitToView() {
+    if (sideLength <= 0) {
+        return;
+    }
+
+    // Small sprites get a whole number of screen pixels per canvas pixel, large ones are scaled down to fit
+    zoom = uiMinSide >= sideLength ? double(uiMinSide / sideLength) : double(uiMinSide) / sideLength;
+    zoom = std::clamp(zoom, MIN_ZOOM, MAX_ZOOM);
+    pan = QPointF(0, 0);
+}
+
+double Canvas::steppedZoom(bool isZoomingIn) const {
+    double newZoom = isZoomingIn ? zoom * ZOOM_FACTOR : zoom / ZOOM_FACTOR;
+
+    // From one screen pixel per canvas pixel up, only whole numbers are used so every cell is the same size
+    if (newZoom >= 1) {
+        newZoom = isZoomingIn ? std::max(std::round(newZoom), std::floor(zoom) + 1)
+                              : std::min(std::round(newZoom), std::ceil(zoom) - 1);
+        newZoom = std::max(newZoom, 1.0);
+    }
+    return std::clamp(newZoom, MIN_ZOOM, MAX_ZOOM);
+}
+
+void Canvas::zoomAt(QPointF widgetPos, double newZoom) {
+    if (newZoom == zoom) {
+        return;
+    }
+
+    // Keep the canvas point under widgetPos in place
+    QPointF canvasPos = (widgetPos - pan) / zoom;
+    zoom = newZoom;
+    pan = widgetPos - canvasPos * zoom;
+    isFitToView = false;
+    clampPan();
+    update();
+}
+
+void Canvas::clampPan() {
+    double extent = sideLength * zoom;
+    double margin = std::min(extent, MIN_VISIBLE_SIZE);
+    pan.setX(std::clamp(pan.x(), margin - extent, std::max(margin - extent, width() - margin)));
+    pan.setY(std::clamp(pan.y(), margin - extent, std::max(margin - extent, height() - margin)));
+}
+
+void Canvas::paintPixels() {
     // Set the current chosen color based on the mode
     QColor color = (currentMode == ERASER) ? Qt::transparent : selectedColor;
 
@@ -123,405 +587,488 @@ void Canvas::paintPixels() {
         case TRIANGLEFILLED:
             triangleFilledPainting(color);
             break;
+        case BUCKET:
+            bucketPainting(color);
+            break;
         default:
             break;
     }
 
-    // Trigger a repaint to apply changes
-    repaint();
+    // Everything this event painted goes out as one batch, so the model applies it and notifies once
+    if (!pendingBatch.isEmpty()) {
+        emit paintedBatch(pendingBatch);
+        pendingBatch.clear();
+    }
+
+    // The frame reports what the painting changed through onFrameRegionChanged, which schedules the repaint
 }
 
-void Canvas::moveAndDisplayPixels(QColor color) {
-    for (int i = 0; i < int(paintedPixels.size()); i++) {
-        QPoint currPixel = paintedPixels[i];
-        QColor currColor = paintedColors[i];
-        emit painted(currPixel, currColor);
+void Canvas::showShapePreview(QColor color) {
+    // The preview only lives in the overlay, so dragging never touches the frame or the art under the shape
+    if (!overlayRect.isEmpty()) {
+        update(widgetRect(overlayRect));
     }
 
-    for (QPoint pixel : shapePixels) {
-        paintedPixels.push_back(pixel);
-        paintedColors.push_back(color);
-        emit painted(pixel, color);
-    }
-    shapePixels.clear();
-}
+    paintRaster.clear();
+    symmetry.apply(shapeRaster, paintRaster);
 
-void Canvas::redrawShape() {
-    for (QPoint shapePixel : shapePixels) {
-        emit painted(shapePixel, Qt::transparent);
+    overlayRect = paintRaster.boundingRect();
+    if (overlayRect.isNull()) {
+        overlayMask = QImage();
+        return;
     }
 
-    for (int i = 0; i < int(paintedPixels.size()); i++) {
-        QPoint currPixel = paintedPixels[i];
-        QColor currColor = paintedColors[i];
-        emit painted(currPixel, currColor);
+    overlayMask = QImage(overlayRect.size(), QImage::Format_Alpha8);
+    overlayMask.fill(0);
+    for (const Rasterizer::Span& span : paintRaster.getSpans()) {
+        uchar* row = overlayMask.scanLine(span.y - overlayRect.top());
+        std::memset(row + span.x - overlayRect.left(), 255, span.length);
     }
+    overlayColor = color;
+    update(widgetRect(overlayRect));
 }
 
-void Canvas::brushPainting(QColor color) {
-    paintedPixels.push_back(QPoint(mousePixelPos));
-    paintedColors.push_back(color);
+void Canvas::commitShape() {
+    // The shape is written to the frame exactly once, as it was last previewed
+    commitPaintRaster(overlayColor);
+    shapeRaster.clear();
+    clearOverlay();
+}
 
-    if (isMirrorMode) {
-        QPoint mirroredPixel = mirrorPixel(mousePixelPos);
-        paintedPixels.push_back(mirroredPixel);
-        paintedColors.push_back(color);
-        emit painted(mirroredPixel, color);
+void Canvas::clearOverlay() {
+    if (!overlayRect.isEmpty()) {
+        update(widgetRect(overlayRect));
     }
+    overlayRect = QRect();
+    overlayMask = QImage();
+}
 
-    emit painted(mousePixelPos, color);
+void Canvas::commitPaintRaster(QColor color, bool isBlended) {
+    for (const Rasterizer::Span& span : paintRaster.getSpans()) {
+        pendingBatch.addSpan(span.y, span.x, span.length, color, isBlended);
+    }
+    paintRaster.clear();
 }
 
-void Canvas::eraserPainting(QColor color) {
-    vector<QPoint> newPaintedPixels;
-    vector<QColor> newPaintedColors;
-
-    for (int i = 0; i < int(paintedPixels.size()); i++) {
-        QPoint currPixel = paintedPixels[i];
-        QColor currColor = paintedColors[i];
-        if (!(currPixel.x() == mousePixelPos.x() && currPixel.y() == mousePixelPos.y())) {
-            if (isMirrorMode) {
-                QPoint mirroredPixel = mirrorPixel(currPixel);
-                if (!(mirroredPixel.x() == mousePixelPos.x() && mirroredPixel.y() == mousePixelPos.y())) {
-                    newPaintedPixels.push_back(currPixel);
-                    newPaintedColors.push_back(currColor);
+void Canvas::removeStrokeCoverage() {
+    if (strokeCoverage.empty()) {
+        strokeCoverage.assign((qsizetype(sideLength) * sideLength + 63) / 64, 0);
+    }
+
+    vector<Rasterizer::Span> spans = paintRaster.getSpans();
+    paintRaster.clear();
+    for (const Rasterizer::Span& span : spans) {
+        qsizetype rowStart = qsizetype(span.y) * sideLength;
+        qsizetype first = rowStart + span.x;
+        qsizetype end = first + span.length;
+
+        // A word at a time, keep the runs of pixels that were not painted yet and mark the whole span as painted
+        int runStart = -1;
+        for (qsizetype word = first / 64; word * 64 < end; word++) {
+            qsizetype wordStart = word * 64;
+            int position = int(std::max<qsizetype>(first - wordStart, 0));
+            int limit = int(std::min<qsizetype>(end - wordStart, 64));
+            quint64 inSpan = (limit == 64 ? ~quint64(0) : (quint64(1) << limit) - 1) & (~quint64(0) << position);
+            quint64 unpainted = ~strokeCoverage[word] & inSpan;
+            strokeCoverage[word] |= inSpan;
+
+            // Jump from one edge of a run to the next
+            while (position < limit) {
+                quint64 rest = (runStart >= 0 ? ~unpainted : unpainted) >> position;
+                int next = rest == 0 ? limit : std::min(limit, position + int(qCountTrailingZeroBits(rest)));
+                if (next < limit) {
+                    int x = int(wordStart + next - rowStart);
+                    if (runStart >= 0) {
+                        paintRaster.addSpan(span.y, runStart, x - 1);
+                        runStart = -1;
+                    } else {
+                        runStart = x;
+                    }
                 }
-            } else {
-                newPaintedPixels.push_back(currPixel);
-                newPaintedColors.push_back(currColor);
+                position = next;
             }
         }
+        if (runStart >= 0) {
+            paintRaster.addSpan(span.y, runStart, span.x + span.length - 1);
+        }
     }
+}
 
-    paintedPixels.clear();
-    paintedColors.clear();
-
-    for (int i = 0; i < int(newPaintedPixels.size()); i++) {
-        paintedPixels.push_back(newPaintedPixels[i]);
-        paintedColors.push_back(newPaintedColors[i]);
+void Canvas::paintStroke(QColor color, bool isErasing) {
+    // The path starts where the stroke was last painted, so its symmetric copies connect to theirs
+    vector<QPoint> path;
+    if (hasLastStrokePixel) {
+        path.push_back(lastStrokePixel);
     }
+    vector<QPoint> strokePixels = takeStrokePixels();
+    path.insert(path.end(), strokePixels.begin(), strokePixels.end());
 
-    emit painted(QPoint(mousePixelPos), color);
+    // The copies of the path are stamped with the tip, so the tip keeps its orientation in every copy
+    paintRaster.clear();
+    if (brush.isSinglePixel()) {
+        symmetry.applyPath(path, paintRaster);
+    } else {
+        Rasterizer pathRaster;
+        symmetry.applyPath(path, pathRaster);
+        for (const Rasterizer::Span& span : pathRaster.getSpans()) {
+            brush.stampSpan(span.y, span.x, span.x + span.length - 1, paintRaster);
+        }
+    }
 
-    if (isMirrorMode) {
-        emit painted(mirrorPixel(mousePixelPos), color);
+    // A translucent brush blends over the frame, and only once per pixel and stroke
+    bool isBlended = !isErasing && color.alpha() < 255;
+    if (isBlended) {
+        removeStrokeCoverage();
     }
+    commitPaintRaster(color, isBlended);
 }
 
-void Canvas::squarePainting(QColor color) {
-
-    redrawShape();
-
-    if (isPressingMouse) {
-        shapePixels.clear();
-
-        QPoint startPixel = shapeStartPos;
-        QPoint endPixel = mousePixelPos;
-
-        int x1 = std::min(startPixel.x(), endPixel.x());
-        int y1 = std::min(startPixel.y(), endPixel.y());
-        int x2 = std::max(startPixel.x(), endPixel.x());
-        int y2 = std::max(startPixel.y(), endPixel.y());
-
-        // Top and bottom edges
-        for (int i = x1; i <= x2; ++i) {
-            shapePixels.push_back(QPoint(i, y1)); // Top edge
-            shapePixels.push_back(QPoint(i, y2)); // Bottom edge
-
-            if (isMirrorMode) {
-                shapePixels.push_back(mirrorPixel(QPoint(i, y1)));
-                shapePixels.push_back(mirrorPixel(QPoint(i, y2)));
-            }
-        }
+void Canvas::brushPainting(QColor color) {
+    // Every pixel between the samples of the mouse is painted, so fast drags leave no gaps
+    paintStroke(color, false);
+}
 
-        // Left and right edges
-        for (int j = y1 + 1; j < y2; ++j) {
-            shapePixels.push_back(QPoint(x1, j)); // Left edge
-            shapePixels.push_back(QPoint(x2, j)); // Right edge
+void Canvas::eraserPainting(QColor color) {
+    // A painted pixel is forgotten when erased directly, or through one of its symmetric copies
+    paintStroke(color, true);
+}
 
-            if (isMirrorMode) {
-                shapePixels.push_back(mirrorPixel(QPoint(x1, j)));
-                shapePixels.push_back(mirrorPixel(QPoint(x2, j)));
-            }
-        }
+void Canvas::squarePainting(QColor color) {
 
-        for (QPoint pixel : shapePixels) emit painted(pixel, color);
+    if (isPressingMouse) {
+        shapeRaster.clear();
+        shapeRaster.rect(cornerRect(shapeStartPos, mousePixelPos), false);
+        showShapePreview(color);
     } else {
-        moveAndDisplayPixels(color);
+        commitShape();
     }
 }
 
 void Canvas::squareFilledPainting(QColor color) {
 
-    redrawShape();
-
     if (isPressingMouse) {
-        shapePixels.clear();
-
-        QPoint startPixel = shapeStartPos;
-        QPoint endPixel = mousePixelPos;
+        shapeRaster.clear();
+        shapeRaster.rect(cornerRect(shapeStartPos, mousePixelPos), true);
+        showShapePreview(color);
+    } else {
+        commitShape();
+    }
+}
 
-        int xMin = std::min(startPixel.x(), endPixel.x());
-        int xMax = std::max(startPixel.x(), endPixel.x());
-        int yMin = std::min(startPixel.y(), endPixel.y());
-        int yMax = std::max(startPixel.y(), endPixel.y());
+QRect Canvas::cornerRect(QPoint corner, QPoint oppositeCorner) {
+    // Both corners are inside the rectangle whichever way it was dragged, which QRect::normalized does not keep
+    return QRect(QPoint(std::min(corner.x(), oppositeCorner.x()), std::min(corner.y(), oppositeCorner.y())),
+                 QPoint(std::max(corner.x(), oppositeCorner.x()), std::max(corner.y(), oppositeCorner.y())));
+}
 
-        for (int i = xMin; i <= xMax; i++) {
-            for (int j = yMin; j <= yMax; j++) {
-                shapePixels.push_back(QPoint(i, j));
+int Canvas::shapeRadius() const {
+    QPoint offset = mousePixelPos - shapeStartPos;
+    return int(std::sqrt(double(offset.x()) * offset.x() + double(offset.y()) * offset.y()));
+}
 
-                if (isMirrorMode) {
-                    shapePixels.push_back(mirrorPixel(QPoint(i, j)));
-                }
-            }
-        }
+void Canvas::circlePainting(QColor color) {
 
-        for (QPoint pixel : shapePixels) emit painted(pixel, color);
+    if (isPressingMouse) {
+        int radius = shapeRadius();
+        shapeRaster.clear();
+        shapeRaster.ellipse(shapeStartPos, radius, radius, false);
+        showShapePreview(color);
     } else {
-        moveAndDisplayPixels(color);
+        commitShape();
     }
 }
 
-void Canvas::circlePainting(QColor color) {
+void Canvas::circleFilledPainting(QColor color) {
+    if (isPressingMouse) {
+        int radius = shapeRadius();
+        shapeRaster.clear();
+        shapeRaster.ellipse(shapeStartPos, radius, radius, true);
+        showShapePreview(color);
+    } else {
+        commitShape();
+    }
+}
 
-    redrawShape();
+void Canvas::trianglePainting(QColor color) {
 
     if (isPressingMouse) {
-        shapePixels.clear();
-
-        QPoint center = shapeStartPos;
-        QPoint edge = mousePixelPos;
-        int radius = std::sqrt(std::pow(edge.x() - center.x(), 2) + std::pow(edge.y() - center.y(), 2));
-
-        int x = radius;
-        int y = 0;
-        int decision = 1 - x;
-
-        // Loop to draw the points on the circle's outline with optional mirroring
-        while (y <= x) {
-            // Draw the 8 symmetrical points on the circle
-            QVector<QPoint> circlePoints = {
-                QPoint(center.x() + x, center.y() + y),
-                QPoint(center.x() - x, center.y() + y),
-                QPoint(center.x() + x, center.y() - y),
-                QPoint(center.x() - x, center.y() - y),
-                QPoint(center.x() + y, center.y() + x),
-                QPoint(center.x() - y, center.y() + x),
-                QPoint(center.x() + y, center.y() - x),
-                QPoint(center.x() - y, center.y() - x)
-            };
-
-            for (QPoint point : circlePoints) {
-                shapePixels.push_back(point);
-
-                // If mirroring is enabled, add mirrored pixels
-                if (isMirrorMode) {
-                    shapePixels.push_back(mirrorPixel(point));
-                }
-            }
-
-            y++;
+        // An isosceles triangle with its top edge level with the start position
+        QPoint vertex1 = shapeStartPos;
+        QPoint vertex2(mousePixelPos.x(), shapeStartPos.y());
+        QPoint vertex3((shapeStartPos.x() + mousePixelPos.x()) / 2, mousePixelPos.y());
+
+        shapeRaster.clear();
+        shapeRaster.triangle(vertex1, vertex2, vertex3, false);
+        showShapePreview(color);
+    } else {
+        commitShape();
+    }
+}
 
-            // Update decision parameter
-            if (decision <= 0) {
-                decision += 2 * y + 1;
-            } else {
-                x--;
-                decision += 2 * (y - x) + 1;
-            }
-        }
+void Canvas::triangleFilledPainting(QColor color) {
 
-        for (QPoint pixel : shapePixels) emit painted(pixel, color);
+    if (isPressingMouse) {
+        // An isosceles triangle with its top edge level with the start position
+        QPoint vertex1 = shapeStartPos;
+        QPoint vertex2(mousePixelPos.x(), shapeStartPos.y());
+        QPoint vertex3((shapeStartPos.x() + mousePixelPos.x()) / 2, mousePixelPos.y());
+
+        shapeRaster.clear();
+        shapeRaster.triangle(vertex1, vertex2, vertex3, true);
+        showShapePreview(color);
     } else {
-        moveAndDisplayPixels(color);
+        commitShape();
     }
 }
 
-void Canvas::circleFilledPainting(QColor color) {
-    redrawShape();
+void Canvas::bucketPainting(QColor color) {
+    // Only the click fills, dragging afterwards does not fill again
+    if (hasLastStrokePixel || strokeSamples.empty() || !hasFrame()) {
+        return;
+    }
+    QPoint seed = strokeSamples.front();
+    lastStrokePixel = seed;
+    hasLastStrokePixel = true;
+
+    // Every symmetric copy of the click fills its own region. The regions go out as spans in this event's batch,
+    // so the model applies them as one change.
+    FloodFill floodFill(*foregroundImage, fillOptions);
+    paintRaster.clear();
+    for (QPoint copy : symmetry.images(seed)) {
+        for (const Rasterizer::Span& span : floodFill.fill(copy)) {
+            paintRaster.addSpan(span.y, span.x, span.x + span.length - 1);
+        }
+    }
+    commitPaintRaster(color);
+}
 
-    if (isPressingMouse) {
-        shapePixels.clear();
-
-        QPoint center = shapeStartPos;
-        QPoint edge = mousePixelPos;
-        int radius = std::sqrt(std::pow(edge.x() - center.x(), 2) + std::pow(edge.y() - center.y(), 2));
-
-        int x = radius;
-        int y = 0;
-        int decision = 1 - x;
-
-        // Loop to fill the circle
-        while (y <= x) {
-            // Draw horizontal lines to fill the circle
-            for (int i = center.x() - x; i <= center.x() + x; i++) {
-                shapePixels.push_back(QPoint(i, center.y() + y));
-                shapePixels.push_back(QPoint(i, center.y() - y));
-
-                // Mirroring pixels if isMirrorMode is enabled
-                if (isMirrorMode) {
-                    shapePixels.push_back(mirrorPixel(QPoint(i, center.y() + y)));
-                    shapePixels.push_back(mirrorPixel(QPoint(i, center.y() - y)));
-                }
-            }
+bool Canvas::isSelectionMode() const {
+    return currentMode == SELECT_RECT || currentMode == SELECT_LASSO;
+}
 
-            for (int i = center.x() - y; i <= center.x() + y; i++) {
-                shapePixels.push_back(QPoint(i, center.y() + x));
-                shapePixels.push_back(QPoint(i, center.y() - x));
+void Canvas::selectionPressed(bool isDuplicating) {
+    selectionDragPos = mousePixelPos;
 
-                // Mirroring pixels if isMirrorMode is enabled
-                if (isMirrorMode) {
-                    shapePixels.push_back(mirrorPixel(QPoint(i, center.y() + x)));
-                    shapePixels.push_back(mirrorPixel(QPoint(i, center.y() - x)));
-                }
+    // Pressing inside the selection picks it up. Its pixels are lifted off the frame once, after that moving it
+    // only changes where it floats.
+    if (selection.contains(mousePixelPos)) {
+        if (!selection.isFloating()) {
+            if (!hasFrame()) {
+                return;
             }
+            selection.lift(*foregroundImage);
+            if (!isDuplicating) {
+                eraseSelection();
+            }
+        } else if (isDuplicating) {
+            // Leave a copy of the floating pixels where they are
+            emit pastedPixels(selection.getPixels(), selection.getMask(), selection.getRect().topLeft());
+        }
+        isDraggingSelection = true;
+        return;
+    }
 
-            y++;
+    anchorSelection();
+    selectionStartPos = mousePixelPos;
+    lassoPath.assign(1, mousePixelPos);
+    selectionPreview = QRect(mousePixelPos, mousePixelPos);
+    updateSelectionArea(selectionPreview);
+}
 
-            // Update decision parameter
-            if (decision <= 0) {
-                decision += 2 * y + 1;
-            } else {
-                x--;
-                decision += 2 * (y - x) + 1;
-            }
+void Canvas::selectionDragged() {
+    if (isDraggingSelection) {
+        QPoint offset = mousePixelPos - selectionDragPos;
+        if (offset.isNull()) {
+            return;
         }
+        QRect oldRect = selection.getRect();
+        selection.moveBy(offset);
+        selectionDragPos = mousePixelPos;
+        updateSelectionArea(oldRect.united(selection.getRect()));
+        return;
+    }
 
-        for (QPoint pixel : shapePixels) emit painted(pixel, color);
+    if (lassoPath.empty()) {
+        return;
+    }
+    QRect oldPreview = selectionPreview;
+    if (currentMode == SELECT_LASSO) {
+        if (lassoPath.back() == mousePixelPos) {
+            return;
+        }
+        lassoPath.push_back(mousePixelPos);
+        selectionPreview = selectionPreview.united(QRect(mousePixelPos, mousePixelPos));
     } else {
-        moveAndDisplayPixels(color);
+        selectionPreview = cornerRect(selectionStartPos, mousePixelPos);
     }
+    updateSelectionArea(oldPreview.united(selectionPreview));
 }
 
-void Canvas::trianglePainting(QColor color) {
-
-    redrawShape();
-
-    if (isPressingMouse) {
-        shapePixels.clear();
-
-        // Define the three vertices of the triangle
-        QPoint vertex1 = shapeStartPos; // Start position (first vertex)
-        QPoint vertex2(mousePixelPos.x(), shapeStartPos.y()); // Second vertex (horizontal from start)
-        QPoint vertex3((shapeStartPos.x() + mousePixelPos.x()) / 2, mousePixelPos.y()); // Third vertex (below, forming an isosceles triangle)
-
-        // Helper lambda to draw a line between two points
-        auto drawLine = [&](QPoint p1, QPoint p2) {
-            int x1 = p1.x();
-            int y1 = p1.y();
-            int x2 = p2.x();
-            int y2 = p2.y();
-
-            int dx = abs(x2 - x1), dy = abs(y2 - y1);
-            int sx = (x1 < x2) ? 1 : -1;
-            int sy = (y1 < y2) ? 1 : -1;
-            int err = dx - dy;
-
-            while (true) {
-                shapePixels.push_back(QPoint(x1, y1));
-
-                if (isMirrorMode) {
-                    shapePixels.push_back(mirrorPixel(QPoint(x1, y1)));
-                }
+void Canvas::selectionReleased() {
+    if (isDraggingSelection) {
+        isDraggingSelection = false;
+        return;
+    }
+    if (lassoPath.empty()) {
+        return;
+    }
 
-                if (x1 == x2 && y1 == y2) break;
-                int e2 = 2 * err;
-                if (e2 > -dy) { err -= dy; x1 += sx; }
-                if (e2 < dx) { err += dx; y1 += sy; }
-            }
-        };
+    // A click without a drag only drops the old selection
+    if (currentMode == SELECT_LASSO && lassoPath.size() > 2) {
+        selection.setLasso(lassoPath, sideLength);
+    } else if (currentMode == SELECT_RECT && mousePixelPos != selectionStartPos) {
+        selection.setRect(cornerRect(selectionStartPos, mousePixelPos), sideLength);
+    }
 
-        // Draw the three edges of the triangle
-        drawLine(vertex1, vertex2); // Top edge
-        drawLine(vertex2, vertex3); // Right edge
-        drawLine(vertex3, vertex1); // Left edge
+    // The selection lies inside the preview, so repainting the preview shows it
+    lassoPath.clear();
+    updateSelectionArea(selectionPreview);
+    selectionPreview = QRect();
+}
 
-        for (QPoint pixel : shapePixels) emit painted(pixel, color);
-    } else {
-        moveAndDisplayPixels(color);
+void Canvas::anchorSelection() {
+    if (selection.isEmpty()) {
+        return;
+    }
+    QRect selectionRect = selection.getRect();
+    if (selection.isFloating() && hasFrame()) {
+        emit pastedPixels(selection.getPixels(), selection.getMask(), selectionRect.topLeft());
     }
+    selection.clear();
+    isDraggingSelection = false;
+    updateSelectionArea(selectionRect);
 }
 
-void Canvas::triangleFilledPainting(QColor color) {
-
-    redrawShape();
-
-    if (isPressingMouse) {
-        shapePixels.clear();
-
-        // Define the three vertices of the triangle
-        QPoint vertex1 = shapeStartPos; // Top vertex
-        QPoint vertex2(mousePixelPos.x(), shapeStartPos.y()); // Second vertex (horizontal from start)
-        QPoint vertex3((shapeStartPos.x() + mousePixelPos.x()) / 2, mousePixelPos.y()); // Bottom vertex to form an isosceles triangle
-
-        // Sort vertices by y-coordinate to simplify scanning from top to bottom
-        if (vertex2.y() < vertex1.y()) std::swap(vertex1, vertex2);
-        if (vertex3.y() < vertex1.y()) std::swap(vertex1, vertex3);
-        if (vertex3.y() < vertex2.y()) std::swap(vertex2, vertex3);
-
-        // Lambda to interpolate x-coordinates for a given y between two points
-        auto interpolateX = [](QPoint p1, QPoint p2, int y) -> int {
-            if (p1.y() == p2.y()) return p1.x(); // Avoid division by zero
-            return p1.x() + (y - p1.y()) * (p2.x() - p1.x()) / (p2.y() - p1.y());
-        };
-
-        // Fill the triangle using horizontal scan lines
-        for (int y = vertex1.y(); y <= vertex3.y(); y++) {
-            int xStart, xEnd;
-
-            // Determine the start and end x-coordinates for the current scanline
-            if (y < vertex2.y()) { // Top half (vertex1 to vertex2 and vertex3)
-                xStart = interpolateX(vertex1, vertex3, y);
-                xEnd = interpolateX(vertex1, vertex2, y);
-            } else { // Bottom half (vertex2 to vertex3)
-                xStart = interpolateX(vertex1, vertex3, y);
-                xEnd = interpolateX(vertex2, vertex3, y);
-            }
-
-            // Ensure xStart is less than xEnd
-            if (xStart > xEnd) std::swap(xStart, xEnd);
+void Canvas::eraseSelection() {
+    paintRaster.clear();
+    for (const Rasterizer::Span& span : selection.getSpans()) {
+        paintRaster.addSpan(span.y, span.x, span.x + span.length - 1);
+    }
+    commitPaintRaster(Qt::transparent);
+    if (!pendingBatch.isEmpty()) {
+        emit paintedBatch(pendingBatch);
+        pendingBatch.clear();
+    }
+}
 
-            // Push points for each x position along the scanline
-            for (int x = xStart; x <= xEnd; x++) {
-                shapePixels.push_back(QPoint(x, y));
+QPainterPath Canvas::selectionPreviewPath() const {
+    QPainterPath path;
+    if (lassoPath.empty()) {
+        return path;
+    }
 
-                // Mirroring pixels if isMirrorMode is enabled
-                if (isMirrorMode) {
-                    shapePixels.push_back(mirrorPixel(QPoint(x, y)));
-                }
-            }
+    // The lasso runs through the centers of the pixels, the rectangle around its pixels
+    if (currentMode == SELECT_LASSO) {
+        path.moveTo(QPointF(lassoPath.front()) + QPointF(0.5, 0.5));
+        for (QPoint point : lassoPath) {
+            path.lineTo(QPointF(point) + QPointF(0.5, 0.5));
         }
-
-        for (QPoint pixel : shapePixels) emit painted(pixel, color);
+        path.closeSubpath();
     } else {
-        moveAndDisplayPixels(color);
+        path.addRect(QRectF(selectionPreview));
     }
+    return path;
 }
 
-void Canvas::mouseMoveEvent(QMouseEvent *event) {
-    QPoint localPos = event->pos();
+void Canvas::updateSelectionArea(const QRect& pixelRect) {
+    // Zoomed out, a cell shows a whole block of pixels, and the outline is drawn on the edge of the pixels
+    double margin = std::ceil((1 << mipLevelFor(zoom)) * zoom) + 2;
+    QRectF area(pan + QPointF(pixelRect.topLeft()) * zoom, QSizeF(pixelRect.size()) * zoom);
+    update(area.adjusted(-margin, -margin, margin, margin).toAlignedRect());
+}
 
-    int col = localPos.x() / pixelSize;
-    int row = localPos.y() / pixelSize;
+void Canvas::mouseMoveEvent(QMouseEvent *event) {
+    if (isPanning) {
+        pan += event->position() - lastPanPos;
+        lastPanPos = event->position();
+        isFitToView = false;
+        clampPan();
+        update();
+        return;
+    }
 
-    mousePixelPos = QPoint(col, row);
+    mousePixelPos = convertWorldToPixel(event->pos());
+    hasMousePixelPos = true;
+    if (isSelectionMode()) {
+        if (isPressingMouse) {
+            selectionDragged();
+        }
+        return;
+    }
+    if (!isPressingMouse || !hasMousePixelPos) {
+        return;
+    }
+    if (strokeSamples.empty() || strokeSamples.back() != mousePixelPos) {
+        strokeSamples.push_back(mousePixelPos);
+    }
 
-    if (isPressingMouse && mousePixelPos != QPoint(-1, -1)) paintPixels();
+    // The first move paints right away, the ones arriving within the next interval are painted together
+    if (!strokeTimer.isActive()) {
+        flushStroke();
+        strokeTimer.start();
+    }
 }
 
 void Canvas::mousePressEvent(QMouseEvent *event) {
+    // Dragging with the middle button pans instead of painting
+    if (event->button() == Qt::MiddleButton) {
+        isPanning = true;
+        lastPanPos = event->position();
+        setCursor(Qt::ClosedHandCursor);
+        return;
+    }
+
+    // Right-clicking moves the symmetry center
+    if (event->button() == Qt::RightButton) {
+        symmetry.setCenter((event->position() - pan) / zoom);
+        update();
+        return;
+    }
+
     isPressingMouse = true;
 
     mousePixelPos = convertWorldToPixel(event->pos());
+    hasMousePixelPos = true;
+
+    // Holding Ctrl while picking up the selection drags a copy of it
+    if (isSelectionMode()) {
+        selectionPressed(event->modifiers().testFlag(Qt::ControlModifier));
+        return;
+    }
 
     if (isShapeMode) {
         shapeStartPos = mousePixelPos;
     }
 
-    if (mousePixelPos != QPoint(-1, -1)) paintPixels();
+    // A new stroke does not connect to where the last one ended, and blends over what earlier ones painted
+    hasLastStrokePixel = false;
+    std::fill(strokeCoverage.begin(), strokeCoverage.end(), 0);
+    strokeSamples.clear();
+    if (hasMousePixelPos) {
+        strokeSamples.push_back(mousePixelPos);
+        flushStroke();
+    }
 }
 
 void Canvas::mouseReleaseEvent(QMouseEvent *event) {
+    if (event->button() == Qt::MiddleButton) {
+        isPanning = false;
+        unsetCursor();
+        return;
+    }
+    if (event->button() == Qt::RightButton) {
+        return;
+    }
+    if (isSelectionMode()) {
+        isPressingMouse = false;
+        selectionReleased();
+        return;
+    }
+
+    // Moves still waiting for the timer belong to the stroke
+    strokeTimer.stop();
+    flushStroke();
+
     isPressingMouse = false;
 
     if (isShapeMode) {
@@ -529,32 +1076,50 @@ void Canvas::mouseReleaseEvent(QMouseEvent *event) {
     }
 }
 
-QPoint Canvas::convertWorldToPixel(QPoint mousePos) {
-    int x =  mousePos.x() / pixelSize;
-    int y =  mousePos.y() / pixelSize;
-
-    return QPoint(x, y);
+void Canvas::flushStroke() {
+    if (strokeSamples.empty()) {
+        return;
+    }
+    paintPixels();
+    strokeSamples.clear();
 }
 
-void Canvas::paintCheckerBoard(int resolution) {
-    backgroundPixmap = QPixmap(resolution, resolution);
-    backgroundPixmap.fill(Qt::transparent);
-    QPainter painter(&backgroundPixmap);
-
-    QColor black(117, 117, 117);
-    QColor white(204, 204, 204);
+vector<QPoint> Canvas::takeStrokePixels() {
+    vector<QPoint> pixels;
+    for (QPoint sample : strokeSamples) {
+        if (hasLastStrokePixel) {
+            Rasterizer::appendLine(lastStrokePixel, sample, pixels);
+        } else {
+            pixels.push_back(sample);
+        }
+        lastStrokePixel = sample;
+        hasLastStrokePixel = true;
+    }
+    return pixels;
+}
 
-    for (int row = 0; row < sideLength; ++row) {
-        for (int col = 0; col < sideLength; ++col) {
-            if ((row + col) % 2 == 0) {
-                painter.fillRect(col * pixelSize, row * pixelSize, pixelSize, pixelSize, white);
-            } else {
-                painter.fillRect(col * pixelSize, row * pixelSize, pixelSize, pixelSize, black);
-            }
+void Canvas::wheelEvent(QWheelEvent *event) {
+    if (event->modifiers() & Qt::ControlModifier) {
+        if (event->angleDelta().y() != 0) {
+            zoomAt(event->position(), steppedZoom(event->angleDelta().y() > 0));
         }
+    } else {
+        // Touchpads report pixels, mouse wheels report eighths of a degree, 40 screen pixels per notch
+        QPoint delta = event->pixelDelta().isNull() ? event->angleDelta() / 3 : event->pixelDelta();
+        pan += delta;
+        isFitToView = false;
+        clampPan();
+        update();
     }
+    event->accept();
 }
 
+QPoint Canvas::convertWorldToPixel(QPoint mousePos) {
+    int x = int(std::floor((mousePos.x() - pan.x()) / zoom));
+    int y = int(std::floor((mousePos.y() - pan.y()) / zoom));
+
+    return QPoint(x, y);
+}
 
 void Canvas::resizeEvent(QResizeEvent *event) {
     QWidget::resizeEvent(event);
@@ -563,11 +1128,12 @@ void Canvas::resizeEvent(QResizeEvent *event) {
 
     uiMinSide = qMin(available.width(), available.height());
 
-    pixelSize = uiMinSide / sideLength;
-
-    paintCheckerBoard(uiMinSide);
-
-    if (foregroundPixmap != nullptr) {
-        repaint();
+    if (sideLength > 0) {
+        if (isFitToView) {
+            fitToView();
+        } else {
+            clampPan();
+        }
+        update();
     }
 }
@@ -16,12 +16,20 @@
 #ifndef CANVAS_H
 #define CANVAS_H
 
+#include "brush.h"
+#include "floodfill.h"
 #include "frame.h"
+#include "paintbatch.h"
+#include "rasterizer.h"
+#include "selection.h"
+#include "symmetry.h"
 #include <QWidget>
 #include <QPixmap>
 #include <QPainter>
 #include <QColor>
 #include <QPoint>
+#include <QPointF>
+#include <QTimer>
 #include <vector>
 
 using std::vector;
@@ -43,7 +51,10 @@ public:
         SQUARE = 4,
         SQUAREFILLED = 5,
         TRIANGLE = 6,
-        TRIANGLEFILLED = 7
+        TRIANGLEFILLED = 7,
+        BUCKET = 8,
+        SELECT_RECT = 9,
+        SELECT_LASSO = 10
     };
 
     const QColor DEFAULT_COLOR = Qt::black;
@@ -56,8 +67,16 @@ public:
     ~Canvas();
 
 signals:
-    void painted(QPoint pixelPos, QColor color);
-    void erased(QPoint pixelPos);
+    /// \brief Signal emitted once per input event with everything the event painted, in painting order.
+    /// \param batch The painted spans. Only valid for the duration of the signal.
+    void paintedBatch(const PaintBatch& batch);
+
+    /// \brief Signal emitted when pixels are written into the frame wherever a mask is set, e.g. when a floating
+    /// selection is anchored.
+    /// \param pixels The pixels, in Frame::FORMAT.
+    /// \param mask Where to write them, in Format_Alpha8 with the size of pixels.
+    /// \param position Where the top left corner of pixels goes, in canvas pixels.
+    void pastedPixels(const QImage& pixels, const QImage& mask, QPoint position);
 
 public slots:
     /// \brief Slot to capture when the user selects a different tool mode.
@@ -74,10 +93,25 @@ public slots:
     void onCurrentColorSet(int r, int g, int b, int a);
 
     /// \brief Slot to capture when the user turns on mirror mode functionality of the canvas.
-    /// When mirror mode functionality is on, drawn pixels are reflected across the Y axis of the canvas.
+    /// When mirror mode functionality is on, drawn pixels are reflected across the vertical axis through the
+    /// symmetry center.
     /// \param enabled Whether mirror mode is enabled.
     void onMirrorModeSet(bool enabled);
 
+    /// \brief Slot to capture when the user turns on mirroring from top to bottom. Drawn pixels are then
+    /// reflected across the horizontal axis through the symmetry center.
+    /// \param enabled Whether mirroring from top to bottom is enabled.
+    void onMirrorTopBottomSet(bool enabled);
+
+    /// \brief Slot to capture when the user picks how many turned copies of every drawn pixel to paint around
+    /// the symmetry center.
+    /// \param count The amount of copies, 1 for none, up to Symmetry::MAX_ROTATIONS.
+    void onRotationalSymmetrySet(int count);
+
+    /// \brief Slot to move the symmetry center back to the middle of the canvas. Right-clicking the canvas
+    /// moves it elsewhere.
+    void onSymmetryCenterReset();
+
     /// \brief Slot to capture when the user changes the selected frame to work on.
     /// The pixels drawn on the canvas will be repainted to reflect the selected frame.
     /// \param newSelectedFrame A reference to the newly selected frame.
@@ -87,36 +121,192 @@ public slots:
     /// The canvas will be redrawn to reflect the newly selected dimensions.
     void onSideLengthChanged(int newSideLength);
 
+    /// \brief Slot to capture when part of the selected frame changes. Only the widget area covering the
+    /// changed canvas pixels is scheduled for a repaint.
+    /// \param pixelRect The changed part of the frame, in canvas pixels.
+    void onFrameRegionChanged(const QRect& pixelRect);
+
+    /// \brief Slot to capture when the user changes the width of the brush and eraser tip.
+    /// \param size The width in pixels, from 1 to Brush::MAX_SIZE.
+    void onBrushSizeSet(int size);
+
+    /// \brief Slot to capture when the user switches the shape of the brush and eraser tip.
+    /// \param shape The Brush::Shape. The custom shape is only taken once a custom tip was loaded.
+    void onBrushShapeSet(int shape);
+
+    /// \brief Slot to capture when the user loads a custom tip for the brush and eraser, and switch to it.
+    /// \param mask The image of the tip, see Brush::setCustomMask.
+    /// \return False if the image cannot be used as a tip.
+    bool onCustomBrushSet(const QImage& mask);
+
+    /// \brief Slot to capture whether the bucket tool also fills through pixels that only touch at a corner.
+    /// \param enabled True for 8-connectivity, false for 4-connectivity.
+    void onFillDiagonalSet(bool enabled);
+
+    /// \brief Slot to capture how far a color may be from the clicked one for the bucket tool to fill it.
+    /// \param tolerance The largest difference allowed per channel, from 0 to FloodFill::MAX_TOLERANCE.
+    void onFillToleranceSet(int tolerance);
+
+    /// \brief Slot to capture whether the bucket tool fills every matching pixel of the frame instead of only
+    /// the region around the clicked pixel.
+    /// \param enabled Whether to fill every matching pixel.
+    void onFillAllMatchingSet(bool enabled);
+
+    /// \brief Slot to select the whole frame.
+    void onSelectAll();
+
+    /// \brief Slot to drop the selection, writing floating pixels into the frame where they are.
+    void onDeselect();
+
+    /// \brief Slot to copy the selected pixels, with their shape and position, for onPaste.
+    void onCopy();
+
+    /// \brief Slot to copy the selected pixels and erase them.
+    void onCut();
+
+    /// \brief Slot to paste the copied pixels as a floating selection, where they were copied from. The selected
+    /// frame may be another one than the one they were copied from.
+    void onPaste();
+
+    /// \brief Slot to erase the selected pixels and drop the selection.
+    void onDeleteSelection();
+
+    /// \brief Slot to zoom in on the center of the canvas widget.
+    void onZoomIn();
+
+    /// \brief Slot to zoom out from the center of the canvas widget.
+    void onZoomOut();
+
+    /// \brief Slot to fit the whole canvas into the widget again. The canvas keeps fitting the widget while it
+    /// is resized, until the user zooms or pans.
+    void onZoomToFit();
+
 private:
-    const int DEFAULT_PIXEL_SIZE = 50;
+    const double MIN_ZOOM = 1.0 / 64;
+    const double MAX_ZOOM = 64;
+    const double ZOOM_FACTOR = 1.25;
+    // Transparent pixels show a checkerboard whose squares are at least this many screen pixels wide
+    const double MIN_CHECKER_SIZE = 8;
+    // How much of the canvas always stays in view while panning, in screen pixels
+    const double MIN_VISIBLE_SIZE = 32;
 
     Ui::Canvas *ui;
 
     int uiMinSide = 500;
-    int sideLength;
-    int pixelSize;
-    int canvasSize;
-
+    int sideLength = 0;
+
+    // Screen pixels per canvas pixel, below 1 when zoomed out
+    double zoom = 1;
+    // Where the top left corner of the canvas is in the widget
+    QPointF pan;
+    bool isFitToView = true;
+    bool isPanning = false;
+    QPointF lastPanPos;
+
+    // Where the mouse last was, in canvas pixels. Every point is a valid position, pixels left of or above the
+    // canvas included, so whether there is one is kept apart.
     QPoint mousePixelPos;
+    bool hasMousePixelPos = false;
     bool isPressingMouse;
 
-    QColor selectedColor;
+    // Roughly one display refresh, the most often mouse moves are painted
+    const int STROKE_INTERVAL = 16;
+    // Mouse positions in canvas pixels that were not painted yet, painted together when strokeTimer fires
+    vector<QPoint> strokeSamples;
+    QTimer strokeTimer;
+    // Where the stroke was last painted, so the next samples connect to it
+    QPoint lastStrokePixel;
+    bool hasLastStrokePixel = false;
 
-    QPixmap backgroundPixmap;
-    QPixmap* foregroundPixmap;
+    QColor selectedColor;
 
-    vector<QPoint> paintedPixels;
-    vector<QColor> paintedColors;
+    const QRgb CHECKER_LIGHT = qRgb(204, 204, 204);
+    const QRgb CHECKER_DARK = qRgb(117, 117, 117);
+    const QColor SYMMETRY_GUIDE_COLOR = QColor(255, 0, 128, 160);
+    // In screen pixels
+    const double SYMMETRY_CENTER_RADIUS = 4;
+    // The selection outline is dashed dark over a solid light line, so it shows on any pixels
+    const QColor SELECTION_LIGHT_COLOR = Qt::white;
+    const QColor SELECTION_DARK_COLOR = Qt::black;
+
+    const QImage* foregroundImage = nullptr;
+
+    // The frame downsampled by 2, 4, 8 and so on in premultiplied ARGB, built the first time the zoom calls for
+    // them. mipLevels[i] is level i + 1, level 0 being the frame itself.
+    vector<QImage> mipLevels;
+
+    // The cells of the shown mip level composited over the checkerboard, one pixel per cell, covering the visible
+    // cells and a margin around them so small pans reuse it. A change of the frame only composites the cells it
+    // touched again.
+    QImage displayCache;
+    // The cells of displayLevel that displayCache covers, empty until it is built for the current frame
+    QRect displayCells;
+    int displayLevel = 0;
+    int displayCheckerCells = 0;
+    bool displayHasFrame = false;
+
+    // The shape preview or the floating selection composited like displayCache: opaque on the cells it covers and
+    // transparent elsewhere, so drawing it over displayCache replaces those cells. Moving or changing it only
+    // composites the cells it covers again.
+    struct DisplayLayer {
+        QImage image;
+        // The cells of displayLevel the image covers
+        QRect cells;
+        // What the image was composited from
+        QRect pixelRect;
+        qint64 maskKey = 0;
+        qint64 pixelsKey = 0;
+        QRgb color = 0;
+    };
+    DisplayLayer overlayLayer;
+    DisplayLayer floatingLayer;
 
     enum Mode currentMode = DEFAULT_MODE;
 
-    bool isMirrorMode;
+    // The copies every tool paints, across mirror axes and rotations around a center
+    Symmetry symmetry;
     bool isShapeMode;
 
-    vector<QPoint> shapePixels;
+    // The spans of the shape being dragged, not clipped yet so symmetry can bring parts outside the frame in
+    Rasterizer shapeRaster;
+    // What the current tool paints after symmetry, clipped to the frame
+    Rasterizer paintRaster;
+
+    // The shape being dragged, drawn over the frame at display time only. The mask covers overlayRect, in
+    // canvas pixels, and is non-zero where the shape is.
+    QImage overlayMask;
+    QRect overlayRect;
+    QColor overlayColor;
+
+    // The tip of the brush and the eraser
+    Brush brush;
+    // One bit per pixel a translucent brush already blended during the current stroke, so overlapping stamps do
+    // not build up. Allocated by the first translucent stroke, cleared when a stroke starts.
+    vector<quint64> strokeCoverage;
+
+    // How the bucket tool finds the region it fills
+    FloodFill::Options fillOptions;
+
+    // What the current input event painted, sent to the model in one signal at the end of paintPixels
+    PaintBatch pendingBatch;
 
     QPoint shapeStartPos;
 
+    // The pixels picked with the selection tools. Dragging the selection makes it float over the frame.
+    Selection selection;
+    bool isDraggingSelection = false;
+    // Where the mouse was when the selection was last moved
+    QPoint selectionDragPos;
+    // The rectangle or lasso being dragged out, and the canvas pixels its outline covers
+    QPoint selectionStartPos;
+    vector<QPoint> lassoPath;
+    QRect selectionPreview;
+
+    // What onCopy copied, for onPaste
+    QImage clipboardPixels;
+    QImage clipboardMask;
+    QPoint clipboardPosition;
+
     /// \brief Overriden paintEvent to draw the backing pixmap to the canvas.
     /// \param A pointer to the QPaintEvent which provides information about drawable widget.
     void paintEvent(QPaintEvent *event) override;
@@ -135,16 +325,31 @@ private:
     /// \param event A pointer to the QMouseEvent to provide information about mouse behaviour.
     void mouseReleaseEvent(QMouseEvent *event) override;
 
-    /// \brief Shape tools helper method that paints the pixels of the shape to the screen permanently.
+    /// \brief Overriden wheelEvent to pan the canvas, or to zoom around the mouse while Ctrl is held.
+    /// \param event A pointer to the QWheelEvent to provide information about the scroll.
+    void wheelEvent(QWheelEvent *event) override;
+
+    /// \brief Shape tools helper method that shows the shape in the overlay while the mouse is dragged, without
+    /// touching the frame.
     /// \param color The color of the shape pixels.
-    void moveAndDisplayPixels(QColor color);
+    void showShapePreview(QColor color);
+
+    /// \brief Shape tools helper method that paints the previewed shape to the frame permanently.
+    void commitShape();
 
-    /// \brief Shape tools helper method that redraws the shape with the new positions when the mouse moves.
-    void redrawShape();
+    /// \brief Removes the shape preview from the overlay.
+    void clearOverlay();
 
     /// \brief Paint pixels to the screen defined by user actions, tool selection, and color selection.
     void paintPixels();
 
+    /// \brief Paints the mouse moves collected since the last time as one batch.
+    void flushStroke();
+
+    /// \brief Returns every pixel of the line through the collected mouse moves, starting from where the stroke
+    /// was last painted, and moves that point to the last move.
+    vector<QPoint> takeStrokePixels();
+
     /// \brief Helper method for paintPixels when BRUSH mode is selected.
     /// \param color The color of the brush.
     void brushPainting(QColor color);
@@ -161,6 +366,14 @@ private:
     /// \param color The color of the filled square.
     void squareFilledPainting(QColor color);
 
+    /// \brief Returns the rectangle of pixels between two corners, including both of them.
+    /// \param corner One corner, in canvas pixels.
+    /// \param oppositeCorner The opposite corner, in canvas pixels.
+    static QRect cornerRect(QPoint corner, QPoint oppositeCorner);
+
+    /// \brief Returns the radius of the circle being dragged, the distance from its center to the mouse.
+    int shapeRadius() const;
+
     /// \brief Helper method for the paintPixels when the CIRCLE mode is selected.
     /// \param color The color of the circle.
     void circlePainting(QColor color);
@@ -173,20 +386,151 @@ private:
     /// \param color The color of the triangle.
     void trianglePainting(QColor color);
 
+    /// \brief Helper method for the paintPixels when the BUCKET mode is selected.
+    /// \param color The color to fill with.
+    void bucketPainting(QColor color);
+
     /// \brief Helper method for the paintPixels when the TRIANGLEFILLED mode is selected.
     /// \param color The color of the filled triangle.
     void triangleFilledPainting(QColor color);
 
+    /// \brief Checks if the current tool picks pixels instead of painting them.
+    bool isSelectionMode() const;
+
+    /// \brief Selection tools helper method for a press: lifts the selection to drag it when the press is inside
+    /// it, starts a new selection otherwise.
+    /// \param isDuplicating Whether a copy of the dragged pixels stays behind.
+    void selectionPressed(bool isDuplicating);
+
+    /// \brief Selection tools helper method for a mouse move: moves the floating selection, or extends the
+    /// rectangle or lasso being dragged out.
+    void selectionDragged();
+
+    /// \brief Selection tools helper method for a release: selects what the rectangle or lasso encloses.
+    void selectionReleased();
+
+    /// \brief Writes a floating selection into the frame where it is, and drops the selection.
+    void anchorSelection();
+
+    /// \brief Erases the pixels of the frame under the selection as one batch.
+    void eraseSelection();
+
+    /// \brief Returns the rectangle or lasso being dragged out, in canvas pixels.
+    QPainterPath selectionPreviewPath() const;
+
+    /// \brief Schedules a repaint of the widget area showing canvas pixels and a selection outline around them.
+    /// \param pixelRect The canvas pixels, which may lie partly outside the frame.
+    void updateSelectionArea(const QRect& pixelRect);
+
     /// \brief Converts the XY position of the mouse in world space to a point on the canvas for use in selecting specific pixels.
     /// \param mousePos The position of the mouse.
     QPoint convertWorldToPixel(QPoint mousePos);
 
-    /// \brief Draws the background pixmap as a checkerboard signaling transparent pixels to the user.
-    void paintCheckerBoard(int resolution);
-
-    /// \brief Draws a set of pixels reflected across the Y axis.
-    /// \param pixelPositions The position of the pixels to be reflected across the Y axis.
-    QPoint mirrorPixel(QPoint pixelPosition);
+    /// \brief Checks if the selected frame is known and already has the side length of the canvas.
+    bool hasFrame() const;
+
+    /// \brief Returns the color table of an indexed frame, premultiplied like the pixels of an ARGB frame.
+    QList<QRgb> premultipliedColorTable() const;
+
+    /// \brief Returns the premultiplied color of one cell of a mip level.
+    /// \param level The mip level, 0 for the frame itself.
+    /// \param x The column of the cell.
+    /// \param y The row of the cell.
+    /// \param colorTable The result of premultipliedColorTable, used by level 0 of an indexed frame.
+    QRgb cellColor(int level, int x, int y, const QList<QRgb>& colorTable) const;
+
+    /// \brief Returns the amount of cells along a side of a mip level.
+    /// \param level The mip level.
+    int levelSideLength(int level) const;
+
+    /// \brief Returns the mip level to draw at a zoom, the deepest one whose cells are at most a screen pixel.
+    /// \param zoomFactor Screen pixels per canvas pixel.
+    int mipLevelFor(double zoomFactor) const;
+
+    /// \brief Builds the mip levels up to a level, if they were not built yet.
+    /// \param level The deepest level needed.
+    void ensureMipLevel(int level);
+
+    /// \brief Brings every built mip level up to date with a changed part of the frame.
+    /// \param pixelRect The changed part of the frame, in canvas pixels.
+    void updateMipLevels(const QRect& pixelRect);
+
+    /// \brief Averages 2x2 cells of the level below into cells of a mip level.
+    /// \param level The mip level to write, at least 1.
+    /// \param cellRect The cells to write.
+    void downsample(int level, const QRect& cellRect);
+
+    /// \brief Drops displayCache and the display layers, so the next paint composites them again.
+    void resetDisplayCache();
+
+    /// \brief Points displayCache at a new range of cells of displayLevel and composites all of them.
+    /// \param visibleCells The cells in view, displayCache covers them and a margin around them.
+    void rebuildDisplayCache(const QRect& visibleCells);
+
+    /// \brief Composites cells of displayCache again from the frame.
+    /// \param cellRect The cells of displayLevel, only the ones displayCache covers are composited.
+    void refreshDisplayCache(const QRect& cellRect);
+
+    /// \brief Composites a display layer again if what it shows moved or changed since it was last composited.
+    /// \param layer The layer.
+    /// \param pixelRect Where the layer is, in canvas pixels. It may lie partly outside the frame.
+    /// \param mask Non-zero where the layer covers the frame, in Format_Alpha8 with the size of pixelRect.
+    /// \param pixels The premultiplied pixels of the layer with the size of pixelRect, or nullptr for a single color.
+    /// \param color The premultiplied color of the layer when pixels is nullptr.
+    void updateDisplayLayer(DisplayLayer& layer, const QRect& pixelRect, const QImage& mask, const QImage* pixels, QRgb color);
+
+    /// \brief Returns a premultiplied pixel composited over the checkerboard square under a cell of displayLevel.
+    /// \param pixel The premultiplied pixel.
+    /// \param x The column of the cell.
+    /// \param y The row of the cell.
+    QRgb overChecker(QRgb pixel, int x, int y) const;
+
+    /// \brief Draws the part of an image of cells that lies in a range of cells, one block of screen pixels per cell.
+    /// \param painter The painter of the widget.
+    /// \param image The image, one pixel per cell of the shown mip level.
+    /// \param imageCells The cells the image covers.
+    /// \param cellRect The cells to draw.
+    /// \param cellSize Screen pixels per cell.
+    void drawCells(QPainter& painter, const QImage& image, const QRect& imageCells, const QRect& cellRect, double cellSize) const;
+
+    /// \brief Maps a part of the widget to the cells of a mip level under it.
+    /// \param area The part of the widget.
+    /// \param level The mip level.
+    QRect cellsUnder(const QRect& area, int level) const;
+
+    /// \brief Maps a part of the frame to the part of the widget showing it.
+    /// \param pixelRect The part of the frame, in canvas pixels.
+    QRect widgetRect(const QRect& pixelRect) const;
+
+    /// \brief Sets the zoom so the whole canvas fits into the widget.
+    void fitToView();
+
+    /// \brief Returns the next zoom step. Zoom is fractional below one screen pixel per canvas pixel and whole
+    /// above it.
+    /// \param isZoomingIn Whether to step in or out.
+    double steppedZoom(bool isZoomingIn) const;
+
+    /// \brief Zooms while keeping the canvas point under a widget position in place.
+    /// \param widgetPos The position in the widget.
+    /// \param newZoom The new zoom.
+    void zoomAt(QPointF widgetPos, double newZoom);
+
+    /// \brief Keeps part of the canvas in view.
+    void clampPan();
+
+    /// \brief Adds the spans of paintRaster to the batch of this event.
+    /// \param color The color to paint them with.
+    /// \param isBlended Whether the color is blended over the pixels instead of replacing them.
+    void commitPaintRaster(QColor color, bool isBlended = false);
+
+    /// \brief Removes the pixels the current stroke already painted from paintRaster, and remembers the rest as
+    /// painted.
+    void removeStrokeCoverage();
+
+    /// \brief Adds the symmetric copies of the pixels the brush or the eraser moved over to the batch of this event.
+    /// \param color The color to paint them with.
+    /// \param isErasing Whether the pixels are erased instead of painted.
+    void paintStroke(QColor color, bool isErasing);
 
     /// \brief Overriden resizeEvent of QWidger, to redraw the canvas to fit inside the UI.
     /// \param event QT event parent.
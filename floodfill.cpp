@@ -0,0 +1,218 @@
+/*
+    Authors: Zhuyi Bu, Zhenzhi Liu, Justin Melore, Maxwell Rodgers, Duke Nguyen, Minh Khoa Ngo
+    Github usernames: 1144761429, 0doxes0, JustinMelore, maxdotr, duke7012, Mkhoa161
+    Date: November 21st, 2024
+    Class: CS3505, Fall 2024
+    Assignment - A8: Sprite Editor Implementation
+
+    The cpp file for the FloodFill class.
+*/
+
+#include "floodfill.h"
+#include <algorithm>
+#include <cstdlib>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// std::clamp takes its bounds by reference, so the constant needs a definition
+const int FloodFill::MAX_TOLERANCE;
+
+FloodFill::FloodFill(const QImage& image, const Options& options)
+    : image(image)
+    , options(options)
+    , sideLength(image.width())
+    , isIndexed(image.format() == QImage::Format_Indexed8) {
+    this->options.tolerance = std::clamp(options.tolerance, 0, MAX_TOLERANCE);
+    matchingIndices.fill(false);
+}
+
+std::vector<Rasterizer::Span> FloodFill::fill(QPoint seed) {
+    std::vector<Rasterizer::Span> spans;
+    if (seed.x() < 0 || seed.y() < 0 || seed.x() >= sideLength || seed.y() >= image.height()) {
+        return spans;
+    }
+    setTarget(seed);
+
+    // Filling every matching pixel is one pass over the rows
+    if (options.isGlobal) {
+        for (int y = 0; y < image.height(); y++) {
+            int x = 0;
+            while (x < sideLength) {
+                if (!matches(x, y)) {
+                    x++;
+                    continue;
+                }
+                int end = runEnd(x, y);
+                spans.push_back(Rasterizer::Span{y, x, end - x});
+                x = end;
+            }
+        }
+        return spans;
+    }
+
+    visited.assign((qsizetype(sideLength) * image.height() + 63) / 64, 0);
+
+    // Every seed on the stack is a matching pixel. Its whole run is taken at once, and the rows above and below
+    // get one new seed per matching run they share with it.
+    std::vector<QPoint> seeds;
+    seeds.push_back(seed);
+    int reach = options.isDiagonal ? 1 : 0;
+
+    while (!seeds.empty()) {
+        QPoint pixel = seeds.back();
+        seeds.pop_back();
+
+        // Runs are always visited whole, so one visited pixel means the run was already taken
+        if (isVisited(pixel.x(), pixel.y())) {
+            continue;
+        }
+
+        int left = runStart(pixel.x(), pixel.y());
+        int right = runEnd(pixel.x(), pixel.y()) - 1;
+        markVisited(pixel.y(), left, right);
+        spans.push_back(Rasterizer::Span{pixel.y(), left, right - left + 1});
+
+        int from = std::max(left - reach, 0);
+        int to = std::min(right + reach, sideLength - 1);
+        for (int y : {pixel.y() - 1, pixel.y() + 1}) {
+            if (y < 0 || y >= image.height()) {
+                continue;
+            }
+
+            int x = from;
+            while (x <= to) {
+                if (!matches(x, y)) {
+                    x++;
+                    continue;
+                }
+                if (!isVisited(x, y)) {
+                    seeds.push_back(QPoint(x, y));
+                }
+                x = runEnd(x, y);
+            }
+        }
+    }
+
+    return spans;
+}
+
+void FloodFill::setTarget(QPoint seed) {
+    if (!isIndexed) {
+        target = reinterpret_cast<const QRgb*>(image.constScanLine(seed.y()))[seed.x()];
+        return;
+    }
+
+    // For an indexed frame the matching is decided once per palette entry instead of once per pixel
+    QList<QRgb> colorTable = image.colorTable();
+    uchar seedIndex = image.constScanLine(seed.y())[seed.x()];
+    target = seedIndex < colorTable.size() ? qPremultiply(colorTable[seedIndex]) : 0;
+    matchingIndices.fill(false);
+    matchingIndices[seedIndex] = true;
+    for (int i = 0; i < colorTable.size(); i++) {
+        if (isWithinTolerance(qPremultiply(colorTable[i]), target, options.tolerance)) {
+            matchingIndices[i] = true;
+        }
+    }
+}
+
+bool FloodFill::matches(int x, int y) const {
+    if (isIndexed) {
+        return matchingIndices[image.constScanLine(y)[x]];
+    }
+    return isWithinTolerance(reinterpret_cast<const QRgb*>(image.constScanLine(y))[x], target, options.tolerance);
+}
+
+int FloodFill::runEnd(int x, int y) const {
+    if (isIndexed) {
+        const uchar* row = image.constScanLine(y);
+        while (x < sideLength && matchingIndices[row[x]]) {
+            x++;
+        }
+        return x;
+    }
+
+    const QRgb* row = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+#ifdef __SSE2__
+    // Four pixels at a time: the per-byte distance to the target minus the tolerance is zero where they match
+    const __m128i targetVector = _mm_set1_epi32(int(target));
+    const __m128i toleranceVector = _mm_set1_epi8(char(options.tolerance));
+    const __m128i zero = _mm_setzero_si128();
+    while (x + 4 <= sideLength) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+        __m128i distance = _mm_or_si128(_mm_subs_epu8(pixels, targetVector), _mm_subs_epu8(targetVector, pixels));
+        __m128i excess = _mm_subs_epu8(distance, toleranceVector);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(excess, zero)) != 0xFFFF) {
+            break;
+        }
+        x += 4;
+    }
+#endif
+    while (x < sideLength && isWithinTolerance(row[x], target, options.tolerance)) {
+        x++;
+    }
+    return x;
+}
+
+int FloodFill::runStart(int x, int y) const {
+    if (isIndexed) {
+        const uchar* row = image.constScanLine(y);
+        while (x > 0 && matchingIndices[row[x - 1]]) {
+            x--;
+        }
+        return x;
+    }
+
+    const QRgb* row = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+#ifdef __SSE2__
+    const __m128i targetVector = _mm_set1_epi32(int(target));
+    const __m128i toleranceVector = _mm_set1_epi8(char(options.tolerance));
+    const __m128i zero = _mm_setzero_si128();
+    while (x >= 4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x - 4));
+        __m128i distance = _mm_or_si128(_mm_subs_epu8(pixels, targetVector), _mm_subs_epu8(targetVector, pixels));
+        __m128i excess = _mm_subs_epu8(distance, toleranceVector);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(excess, zero)) != 0xFFFF) {
+            break;
+        }
+        x -= 4;
+    }
+#endif
+    while (x > 0 && isWithinTolerance(row[x - 1], target, options.tolerance)) {
+        x--;
+    }
+    return x;
+}
+
+bool FloodFill::isVisited(int x, int y) const {
+    qsizetype index = qsizetype(y) * sideLength + x;
+    return (visited[index / 64] & (quint64(1) << (index % 64))) != 0;
+}
+
+void FloodFill::markVisited(int y, int left, int right) {
+    qsizetype first = qsizetype(y) * sideLength + left;
+    qsizetype last = qsizetype(y) * sideLength + right;
+
+    // Whole words at a time, with the partial words at both ends masked
+    qsizetype firstWord = first / 64, lastWord = last / 64;
+    quint64 firstMask = ~quint64(0) << (first % 64);
+    quint64 lastMask = ~quint64(0) >> (63 - last % 64);
+    if (firstWord == lastWord) {
+        visited[firstWord] |= firstMask & lastMask;
+        return;
+    }
+    visited[firstWord] |= firstMask;
+    std::fill(visited.begin() + firstWord + 1, visited.begin() + lastWord, ~quint64(0));
+    visited[lastWord] |= lastMask;
+}
+
+bool FloodFill::isWithinTolerance(QRgb color, QRgb target, int tolerance) {
+    if (tolerance == 0) {
+        return color == target;
+    }
+    return std::abs(qAlpha(color) - qAlpha(target)) <= tolerance
+        && std::abs(qRed(color) - qRed(target)) <= tolerance
+        && std::abs(qGreen(color) - qGreen(target)) <= tolerance
+        && std::abs(qBlue(color) - qBlue(target)) <= tolerance;
+}
@@ -0,0 +1,85 @@
+/*
+    Authors: Zhuyi Bu, Zhenzhi Liu, Justin Melore, Maxwell Rodgers, Duke Nguyen, Minh Khoa Ngo
+    Github usernames: 1144761429, 0doxes0, JustinMelore, maxdotr, duke7012, Mkhoa161
+    Date: November 21st, 2024
+    Class: CS3505, Fall 2024
+    Assignment - A8: Sprite Editor Implementation
+
+    The FloodFill class finds the pixels the bucket tool fills: the region of pixels connected to a seed pixel
+    that match its color, or every matching pixel of the frame. It works on whole runs of a row at a time, so the
+    region comes out as at most a few spans per row, and the pixels of a run are compared several at once where
+    SSE2 is available.
+*/
+
+#ifndef FLOODFILL_H
+#define FLOODFILL_H
+
+#include "rasterizer.h"
+#include <QImage>
+#include <QPoint>
+#include <QRgb>
+#include <array>
+#include <vector>
+
+class FloodFill
+{
+public:
+    /// \brief How the region to fill is found.
+    struct Options {
+        /// Whether pixels that only touch at a corner are connected (8-connectivity) or not (4-connectivity).
+        bool isDiagonal = false;
+        /// How far each premultiplied channel of a pixel may be from the seed color for the pixel to match.
+        int tolerance = 0;
+        /// Whether to fill every matching pixel of the frame, connected to the seed or not.
+        bool isGlobal = false;
+    };
+
+    static const int MAX_TOLERANCE = 255;
+
+    /// \brief Constructor for the flood fill.
+    /// \param image The pixels of the frame, in Frame::FORMAT or in Format_Indexed8. Has to outlive the fill.
+    /// \param options How the region is found.
+    FloodFill(const QImage& image, const Options& options);
+
+    /// \brief fill Find the pixels to fill from a seed pixel.
+    /// \param seed The pixel that was clicked.
+    /// \return The pixels to fill, as spans that do not overlap. Empty if the seed is outside the frame.
+    std::vector<Rasterizer::Span> fill(QPoint seed);
+
+private:
+    const QImage& image;
+    Options options;
+    int sideLength;
+    bool isIndexed;
+
+    // The premultiplied color of the seed, and for an indexed frame, which palette entries match it
+    QRgb target = 0;
+    std::array<bool, 256> matchingIndices;
+
+    // One bit per pixel, set once the pixel's run was added to the region
+    std::vector<quint64> visited;
+
+    /// \brief setTarget Match pixels against the color of a pixel from now on.
+    void setTarget(QPoint seed);
+
+    /// \brief matches Check if a pixel matches the target color.
+    bool matches(int x, int y) const;
+
+    /// \brief runEnd Returns the first column at or after x whose pixel does not match, or the side length.
+    int runEnd(int x, int y) const;
+
+    /// \brief runStart Returns the first column of the matching run that ends right before x, or x if the pixel
+    /// at x - 1 does not match.
+    int runStart(int x, int y) const;
+
+    /// \brief isVisited Check if a pixel was already added to the region.
+    bool isVisited(int x, int y) const;
+
+    /// \brief markVisited Remember that the pixels from left to right of a row were added to the region.
+    void markVisited(int y, int left, int right);
+
+    /// \brief isWithinTolerance Check if every channel of two colors is at most tolerance apart.
+    static bool isWithinTolerance(QRgb color, QRgb target, int tolerance);
+};
+
+#endif // FLOODFILL_H
@@ -14,48 +14,123 @@
 
 #include "frame.h"
 #include <QImage>
+#include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
-#include <QPainter>
+#include <QHash>
+#include <QTransform>
 #include <QtSwap>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 Frame::Frame(int sideLength) {
-    pixmap = QPixmap(sideLength, sideLength);
-    pixmap.fill(Qt::transparent);
     this->sideLength = sideLength;
+
+    if (sideLength >= MIN_TILED_SIDE_LENGTH) {
+        // A large frame starts out compacted into empty tiles, which take no pixel memory at all
+        tiles.resize(tilesPerSide(sideLength) * tilesPerSide(sideLength));
+    } else {
+        image = QImage(sideLength, sideLength, FORMAT);
+        image.fill(Qt::transparent);
+    }
+}
+
+Frame::Frame(int sideLength, const SpriteFile::EncodedFrame& encoded) {
+    this->sideLength = sideLength;
+    this->encoded = encoded;
 }
 
 Frame::Frame(const Frame& other) {
-    pixmap = QPixmap(other.pixmap);
+    // QImage shares its buffer until either side writes to it, which detaches a private copy
+    image = other.image;
+    tiles = other.tiles;
+    colorTable = other.colorTable;
+    isColorTableStale = other.isColorTableStale;
+    dirtyRect = other.dirtyRect;
+    encoded = other.encoded;
+    sideLength = other.sideLength;
 }
 
 Frame& Frame::operator=(Frame other) {
-    qSwap(pixmap, other.pixmap);
+    qSwap(image, other.image);
+    qSwap(tiles, other.tiles);
+    qSwap(colorTable, other.colorTable);
+    qSwap(isColorTableStale, other.isColorTableStale);
+    qSwap(dirtyRect, other.dirtyRect);
+    qSwap(encoded, other.encoded);
+    qSwap(sideLength, other.sideLength);
     return *this;
 }
 
-QJsonArray Frame::convertToJson() {
-    QImage image = pixmap.toImage();
-    QJsonArray pixelArrayJson;
+QByteArray Frame::imageToRowJson(const QImage& image) {
+    static const char HEX_DIGITS[] = "0123456789abcdef";
+    const int MAX_PALETTE_SIZE = 256;
 
-    for (int y = 0; y < image.height(); y++) {
-        for (int x = 0; x < image.width(); x++) {
-            QColor color = image.pixelColor(x,y);
+    QImage argb = image.convertToFormat(QImage::Format_ARGB32);
 
-            QJsonObject pixel;
-            pixel["r"] = color.red();
-            pixel["g"] = color.green();
-            pixel["b"] = color.blue();
-            pixel["a"] = color.alpha();
+    // Collect the colors of the frame, giving up on a palette once two hex digits can no longer index it
+    QList<QRgb> palette;
+    QHash<QRgb, int> paletteIndices;
+    bool usePalette = true;
+    for (int y = 0; y < argb.height() && usePalette; y++) {
+        const QRgb* line = reinterpret_cast<const QRgb*>(argb.constScanLine(y));
+        for (int x = 0; x < argb.width(); x++) {
+            if (!paletteIndices.contains(line[x])) {
+                if (palette.size() == MAX_PALETTE_SIZE) {
+                    usePalette = false;
+                    break;
+                }
+                paletteIndices.insert(line[x], palette.size());
+                palette.append(line[x]);
+            }
+        }
+    }
+
+    auto appendHex = [](char* out, uint value, int digits) {
+        for (int d = digits - 1; d >= 0; d--) {
+            *out++ = HEX_DIGITS[(value >> (4 * d)) & 0xF];
+        }
+    };
 
-            pixelArrayJson.append(pixel);
+    QByteArray json = "{";
+    if (usePalette) {
+        json += "\"palette\":[";
+        for (int i = 0; i < palette.size(); i++) {
+            char color[8];
+            appendHex(color, palette[i], 8);
+            json += (i == 0 ? "\"" : ",\"") + QByteArray(color, 8) + "\"";
         }
+        json += "],";
     }
+    json += "\"rows\":[\n";
 
-    return pixelArrayJson;
+    int digits = usePalette ? (palette.size() <= 16 ? 1 : 2) : 8;
+    QByteArray row(argb.width() * digits, Qt::Uninitialized);
+    for (int y = 0; y < argb.height(); y++) {
+        const QRgb* line = reinterpret_cast<const QRgb*>(argb.constScanLine(y));
+        char* out = row.data();
+        for (int x = 0; x < argb.width(); x++) {
+            appendHex(out, usePalette ? paletteIndices.value(line[x]) : line[x], digits);
+            out += digits;
+        }
+
+        json += "\"" + row + (y == argb.height() - 1 ? "\"\n" : "\",\n");
+    }
+    json += "]}";
+
+    return json;
 }
 
-void Frame::loadFromJson(QJsonValue json) {
+QImage Frame::imageFromJson(const QJsonValue& json, int sideLength) {
+    if (json.isObject()) {
+        return imageFromRowJson(json.toObject(), sideLength);
+    }
+
     QJsonArray pixelArray = json.toArray();
     QImage image(sideLength, sideLength, QImage::Format_ARGB32);
 
@@ -75,41 +150,670 @@ void Frame::loadFromJson(QJsonValue json) {
         }
     }
 
-    QPainter painter(&pixmap);
-    painter.setCompositionMode(QPainter::CompositionMode_Source);
-    painter.drawPixmap(0, 0, QPixmap::fromImage(image));
+    return image;
+}
+
+QImage Frame::imageFromRowJson(const QJsonObject& json, int sideLength) {
+    QList<QRgb> palette;
+    for (QJsonValue color : json["palette"].toArray()) {
+        palette.append(color.toString().toUInt(nullptr, 16));
+    }
+
+    auto hexValue = [](char16_t digit) -> uint {
+        if (digit >= '0' && digit <= '9') return digit - '0';
+        if (digit >= 'a' && digit <= 'f') return digit - 'a' + 10;
+        if (digit >= 'A' && digit <= 'F') return digit - 'A' + 10;
+        return 0;
+    };
+
+    QImage image(sideLength, sideLength, QImage::Format_ARGB32);
+    image.fill(Qt::transparent);
+
+    // The width of a pixel follows from the palette: one hex digit indexes up to 16 colors, two up to 256,
+    // and without a palette every pixel is a full AARRGGBB color
+    int digits = palette.isEmpty() ? 8 : (palette.size() <= 16 ? 1 : 2);
+    QJsonArray rows = json["rows"].toArray();
+    for (int y = 0; y < sideLength && y < rows.size(); y++) {
+        QString row = rows[y].toString();
+        if (row.size() < sideLength * digits) {
+            continue;
+        }
+
+        const QChar* in = row.constData();
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < sideLength; x++) {
+            uint value = 0;
+            for (int d = 0; d < digits; d++) {
+                value = (value << 4) | hexValue((in++)->unicode());
+            }
+
+            if (palette.isEmpty()) {
+                line[x] = value;
+            } else if (value < uint(palette.size())) {
+                line[x] = palette[value];
+            }
+        }
+    }
+
+    return image;
+}
+
+QImage Frame::toImage() const {
+    // Assemble a compacted frame into a temporary copy, so it stays compacted
+    QImage pixels = isTiled() ? assembleTiles(tiles, sideLength, colorTable) : getImage();
+    return pixels.convertToFormat(FORMAT);
+}
+
+void Frame::loadFromImage(const QImage& newImage) {
+    encoded = SpriteFile::EncodedFrame();
+    tiles.clear();
+    colorTable.clear();
+    isColorTableStale = false;
+    if (newImage.isNull()) {
+        image = QImage(sideLength, sideLength, FORMAT);
+        image.fill(Qt::transparent);
+    } else {
+        image = newImage.convertToFormat(FORMAT);
+    }
+    markAllDirty();
+}
+
+void Frame::loadDecoded(const QImage& newImage) {
+    if (!isDecoded()) {
+        loadFromImage(newImage);
+    }
+}
+
+void Frame::loadEncoded(const SpriteFile::EncodedFrame& frame) {
+    encoded = frame;
+    image = QImage();
+    tiles.clear();
+    colorTable.clear();
+    isColorTableStale = false;
+    markAllDirty();
+}
+
+void Frame::loadIndices(const QImage& indices, const QList<QRgb>& newColorTable) {
+    encoded = SpriteFile::EncodedFrame();
+    tiles.clear();
+    isColorTableStale = false;
+    if (indices.isNull() || newColorTable.isEmpty()) {
+        colorTable.clear();
+        image = QImage(sideLength, sideLength, FORMAT);
+        image.fill(Qt::transparent);
+    } else {
+        colorTable = newColorTable;
+        image = indices;
+        image.setColorTable(colorTable);
+    }
+    markAllDirty();
+}
+
+SpriteFile::EncodedFrame Frame::encode() const {
+    if (!isDecoded()) {
+        return encoded;
+    }
+    return SpriteFile::encodeImage(toImage());
+}
+
+Frame::Snapshot Frame::snapshot() const {
+    Snapshot snapshot;
+    if (isTiled()) {
+        snapshot.tiles = tiles;
+        snapshot.colorTable = colorTable;
+        snapshot.sideLength = sideLength;
+    } else if (isDecoded()) {
+        snapshot.image = image;
+        if (isColorTableStale) {
+            snapshot.colorTable = colorTable;
+        }
+    } else {
+        snapshot.encoded = encoded;
+    }
+    return snapshot;
+}
+
+SpriteFile::EncodedFrame Frame::encodeSnapshot(const Snapshot& snapshot) {
+    if (!snapshot.tiles.empty()) {
+        return SpriteFile::encodeImage(assembleTiles(snapshot.tiles, snapshot.sideLength, snapshot.colorTable));
+    }
+    if (snapshot.image.isNull()) {
+        return snapshot.encoded;
+    }
+    return SpriteFile::encodeImage(decodeSnapshot(snapshot, snapshot.image.width()));
+}
+
+SpriteFile::EncodedFrame Frame::encodeJournalSnapshot(const Snapshot& snapshot) {
+    if (!snapshot.tiles.empty() && !snapshot.colorTable.isEmpty()) {
+        return SpriteFile::encodeIndices(assembleTiles(snapshot.tiles, snapshot.sideLength, snapshot.colorTable));
+    }
+    if (snapshot.image.format() == QImage::Format_Indexed8) {
+        return SpriteFile::encodeIndices(snapshot.image);
+    }
+    return encodeSnapshot(snapshot);
+}
+
+QImage Frame::decodeSnapshot(const Snapshot& snapshot, int sideLength) {
+    if (!snapshot.tiles.empty()) {
+        return assembleTiles(snapshot.tiles, sideLength, snapshot.colorTable);
+    }
+    if (snapshot.image.isNull()) {
+        return SpriteFile::decodeImage(snapshot.encoded, sideLength);
+    }
+    if (snapshot.colorTable.isEmpty()) {
+        return snapshot.image;
+    }
+
+    // The copy detaches here on the worker thread rather than in the frame on the GUI thread
+    QImage image = snapshot.image;
+    image.setColorTable(snapshot.colorTable);
+    return image;
+}
+
+bool Frame::isDecoded() const {
+    return encoded.blob.isNull();
+}
+
+void Frame::detachEncoded() {
+    if (!isDecoded()) {
+        // A raw-data QByteArray only detaches into its own buffer when written to
+        encoded.blob = QByteArray(encoded.blob.constData(), encoded.blob.size());
+    }
+}
+
+int Frame::getSideLength() const {
+    return sideLength;
+}
+
+const QImage& Frame::getImage() const {
+    ensureDecoded();
+    return image;
+}
+
+void Frame::ensureDecoded() const {
+    if (!image.isNull()) {
+        if (isColorTableStale) {
+            image.setColorTable(colorTable);
+            isColorTableStale = false;
+        }
+        return;
+    }
+
+    if (isTiled()) {
+        image = assembleTiles(tiles, sideLength, colorTable);
+        return;
+    }
+
+    image = SpriteFile::decodeImage(encoded, sideLength).convertToFormat(FORMAT);
+    if (image.isNull()) {
+        // A corrupt blob leaves an empty frame rather than failing on every access
+        image = QImage(sideLength, sideLength, FORMAT);
+        image.fill(Qt::transparent);
+    }
+
+    encoded = SpriteFile::EncodedFrame();
+}
+
+void Frame::compact() {
+    if (sideLength < MIN_TILED_SIDE_LENGTH || image.isNull()) {
+        return;
+    }
+
+    int count = tilesPerSide(sideLength);
+    int pixelBytes = bytesPerPixel();
+    std::vector<QImage> newTiles(count * count);
+    bool hasOldTiles = tiles.size() == newTiles.size();
+
+    for (int tileY = 0; tileY < count; tileY++) {
+        for (int tileX = 0; tileX < count; tileX++) {
+            int left = tileX * TILE_SIZE;
+            int top = tileY * TILE_SIZE;
+            int widthBytes = std::min(TILE_SIZE, sideLength - left) * pixelBytes;
+            int height = std::min(TILE_SIZE, sideLength - top);
+            const QImage& oldTile = hasOldTiles ? tiles[tileY * count + tileX] : QImage();
+
+            // All zero bytes is transparent in both storage modes, index 0 of a palette is always transparent
+            bool isEmpty = true;
+            bool isUnchanged = !oldTile.isNull();
+            for (int y = 0; y < height && (isEmpty || isUnchanged); y++) {
+                const uchar* line = image.constScanLine(top + y) + left * pixelBytes;
+                isEmpty = isEmpty && std::all_of(line, line + widthBytes, [](uchar byte) { return byte == 0; });
+                isUnchanged = isUnchanged && std::memcmp(line, oldTile.constScanLine(y), widthBytes) == 0;
+            }
+
+            // Empty tiles stay null, unchanged ones keep sharing their data with other copies of the frame
+            if (isEmpty) {
+                continue;
+            }
+            if (isUnchanged) {
+                newTiles[tileY * count + tileX] = oldTile;
+                continue;
+            }
+
+            QImage tile(TILE_SIZE, TILE_SIZE, image.format());
+            tile.fill(0u);
+            for (int y = 0; y < height; y++) {
+                std::memcpy(tile.scanLine(y), image.constScanLine(top + y) + left * pixelBytes, widthBytes);
+            }
+            newTiles[tileY * count + tileX] = tile;
+        }
+    }
+
+    tiles = std::move(newTiles);
+    image = QImage();
+    isColorTableStale = false;
+}
+
+bool Frame::isTiled() const {
+    return image.isNull() && isDecoded();
+}
+
+QImage Frame::thumbnail(int size) const {
+    if (!isTiled() && !isIndexed()) {
+        return getImage().scaled(size, size, Qt::KeepAspectRatio);
+    }
+
+    int count = tilesPerSide(sideLength);
+    QImage thumbnail(size, size, FORMAT);
+    for (int y = 0; y < size; y++) {
+        int sourceY = y * sideLength / size;
+        QRgb* line = reinterpret_cast<QRgb*>(thumbnail.scanLine(y));
+        for (int x = 0; x < size; x++) {
+            int sourceX = x * sideLength / size;
+            if (!isTiled()) {
+                // Looking the indices up in the table leaves a buffer that has not taken the table yet alone
+                line[x] = qPremultiply(colorTable.value(image.constScanLine(sourceY)[sourceX]));
+                continue;
+            }
+            const QImage& tile = tiles[(sourceY / TILE_SIZE) * count + sourceX / TILE_SIZE];
+            if (tile.isNull()) {
+                line[x] = 0;
+            } else if (isIndexed()) {
+                line[x] = qPremultiply(colorTable.value(tile.constScanLine(sourceY % TILE_SIZE)[sourceX % TILE_SIZE]));
+            } else {
+                line[x] = reinterpret_cast<const QRgb*>(tile.constScanLine(sourceY % TILE_SIZE))[sourceX % TILE_SIZE];
+            }
+        }
+    }
+    return thumbnail;
+}
+
+void Frame::toIndexed(const QList<QRgb>& newColorTable) {
+    bool wasTiled = isTiled();
+    if (isIndexed()) {
+        toArgb();
+    }
+    ensureDecoded();
+
+    // Look colors up by their premultiplied value, which is how the pixels are stored
+    QHash<QRgb, uchar> indices;
+    for (int i = newColorTable.size() - 1; i >= 0; i--) {
+        indices.insert(qPremultiply(newColorTable[i]), uchar(i));
+    }
+
+    QImage indexed(sideLength, sideLength, QImage::Format_Indexed8);
+    indexed.setColorTable(newColorTable);
+    for (int y = 0; y < sideLength; y++) {
+        const QRgb* in = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+        uchar* out = indexed.scanLine(y);
+        for (int x = 0; x < sideLength; x++) {
+            auto found = indices.constFind(in[x]);
+            if (found == indices.constEnd()) {
+                found = indices.insert(in[x], uchar(nearestIndex(newColorTable, in[x])));
+            }
+            out[x] = found.value();
+        }
+    }
+
+    image = indexed;
+    colorTable = newColorTable;
+    isColorTableStale = false;
+    tiles.clear();
+    if (wasTiled) {
+        compact();
+    }
+}
+
+void Frame::toArgb() {
+    if (!isIndexed()) {
+        return;
+    }
+
+    bool wasTiled = isTiled();
+    ensureDecoded();
+    image = image.convertToFormat(FORMAT);
+    colorTable.clear();
+    isColorTableStale = false;
+    tiles.clear();
+    if (wasTiled) {
+        compact();
+    }
+}
+
+bool Frame::isIndexed() const {
+    return !colorTable.isEmpty();
+}
+
+void Frame::setColorTable(const QList<QRgb>& newColorTable) {
+    if (!isIndexed()) {
+        return;
+    }
+
+    // Appending entries leaves every pixel as it was, anything else may recolor the whole frame
+    bool isAppended = newColorTable.size() >= colorTable.size()
+                      && std::equal(colorTable.begin(), colorTable.end(), newColorTable.begin());
+    if (!isAppended) {
+        markAllDirty();
+    }
+
+    // The indices stay as they are, only what they point to changes. Tiles carry no table of their own, and a
+    // buffer shared with a copy of the frame would detach every pixel to take the table, so it waits until the
+    // pixels are accessed.
+    colorTable = newColorTable;
+    if (image.isNull()) {
+        return;
+    }
+    if (image.isDetached()) {
+        image.setColorTable(colorTable);
+    } else {
+        isColorTableStale = true;
+    }
+}
+
+QRect Frame::takeDirtyRect() {
+    QRect rect = dirtyRect;
+    dirtyRect = QRect();
+    return rect;
+}
+
+void Frame::markDirty(const QRect& rect) {
+    dirtyRect |= rect;
+}
+
+void Frame::markAllDirty() {
+    dirtyRect = QRect(0, 0, sideLength, sideLength);
+}
+
+bool Frame::collectColors(QSet<QRgb>& colors, int maxColors) const {
+    QImage pixels = toImage();
+    for (int y = 0; y < pixels.height(); y++) {
+        const QRgb* line = reinterpret_cast<const QRgb*>(pixels.constScanLine(y));
+        for (int x = 0; x < pixels.width(); x++) {
+            colors.insert(line[x]);
+        }
+        if (colors.size() > maxColors) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int Frame::nearestIndex(const QList<QRgb>& colorTable, QRgb pixel) {
+    int nearest = 0;
+    int nearestDistance = INT_MAX;
+    for (int i = 0; i < colorTable.size() && nearestDistance > 0; i++) {
+        QRgb color = qPremultiply(colorTable[i]);
+        int distance = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            int difference = int((color >> shift) & 0xFF) - int((pixel >> shift) & 0xFF);
+            distance += difference * difference;
+        }
+        if (distance < nearestDistance) {
+            nearest = i;
+            nearestDistance = distance;
+        }
+    }
+    return nearest;
+}
+
+int Frame::bytesPerPixel() const {
+    return isIndexed() ? 1 : int(sizeof(QRgb));
+}
+
+quint32 Frame::pixelValue(QColor color) const {
+    QRgb pixel = qPremultiply(color.rgba());
+    return isIndexed() ? quint32(nearestIndex(colorTable, pixel)) : pixel;
+}
+
+void Frame::fillPixels(uchar* out, quint32 value, int count, int bytesPerPixel) {
+    if (bytesPerPixel == 1) {
+        std::memset(out, int(value), count);
+    } else {
+        std::fill(reinterpret_cast<QRgb*>(out), reinterpret_cast<QRgb*>(out) + count, QRgb(value));
+    }
+}
+
+void Frame::blendPixels(QRgb* out, QRgb color, int count) {
+    // Premultiplied source-over: each channel becomes source + destination * (255 - source alpha) / 255, with
+    // the division rounded as (v + 128 + ((v + 128) >> 8)) >> 8
+    int inverseAlpha = 255 - qAlpha(color);
+    int i = 0;
+
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i source = _mm_set1_epi32(int(color));
+    const __m128i inverse = _mm_set1_epi16(short(inverseAlpha));
+    const __m128i half = _mm_set1_epi16(128);
+    for (; i + 4 <= count; i += 4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(out + i));
+        __m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pixels, zero), inverse), half);
+        __m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pixels, zero), inverse), half);
+        low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+        high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+        __m128i blended = _mm_adds_epu8(_mm_packus_epi16(low, high), source);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), blended);
+    }
+#endif
+
+    for (; i < count; i++) {
+        QRgb pixel = out[i];
+        auto blend = [inverseAlpha](int source, int destination) {
+            int value = destination * inverseAlpha + 128;
+            return std::min(255, source + ((value + (value >> 8)) >> 8));
+        };
+        out[i] = qRgba(blend(qRed(color), qRed(pixel)), blend(qGreen(color), qGreen(pixel)),
+                       blend(qBlue(color), qBlue(pixel)), blend(qAlpha(color), qAlpha(pixel)));
+    }
+}
+
+uchar* Frame::pixelAddress(int x, int y) {
+    if (!isTiled()) {
+        ensureDecoded();
+        return image.scanLine(y) + x * bytesPerPixel();
+    }
+
+    QImage& tile = tiles[(y / TILE_SIZE) * tilesPerSide(sideLength) + x / TILE_SIZE];
+    if (tile.isNull()) {
+        tile = QImage(TILE_SIZE, TILE_SIZE, isIndexed() ? QImage::Format_Indexed8 : FORMAT);
+        tile.fill(0u);
+    }
+    // Writing through scanLine detaches the tile if another frame still shares it
+    return tile.scanLine(y % TILE_SIZE) + (x % TILE_SIZE) * bytesPerPixel();
+}
+
+int Frame::tilesPerSide(int sideLength) {
+    return (sideLength + TILE_SIZE - 1) / TILE_SIZE;
+}
+
+QImage Frame::assembleTiles(const std::vector<QImage>& tiles, int sideLength, const QList<QRgb>& colorTable) {
+    int count = tilesPerSide(sideLength);
+    bool isIndexed = !colorTable.isEmpty();
+    int pixelBytes = isIndexed ? 1 : int(sizeof(QRgb));
+    QImage image(sideLength, sideLength, isIndexed ? QImage::Format_Indexed8 : FORMAT);
+    if (isIndexed) {
+        image.setColorTable(colorTable);
+    }
+
+    for (int y = 0; y < sideLength; y++) {
+        uchar* line = image.scanLine(y);
+        for (int tileX = 0; tileX < count; tileX++) {
+            const QImage& tile = tiles[(y / TILE_SIZE) * count + tileX];
+            int widthBytes = std::min(TILE_SIZE, sideLength - tileX * TILE_SIZE) * pixelBytes;
+            uchar* out = line + tileX * TILE_SIZE * pixelBytes;
+            if (tile.isNull()) {
+                std::memset(out, 0, widthBytes);
+            } else {
+                std::memcpy(out, tile.constScanLine(y % TILE_SIZE), widthBytes);
+            }
+        }
+    }
+    return image;
+}
+
+void Frame::resize(int newSideLength) {
+    bool wasTiled = isTiled();
+    ensureDecoded();
+    QImage newImage(newSideLength, newSideLength, image.format());
+    newImage.setColorTable(colorTable);
+    newImage.fill(0u);
+
+    int copyLength = std::min(sideLength, newSideLength);
+    for (int y = 0; y < copyLength; y++) {
+        std::memcpy(newImage.scanLine(y), image.constScanLine(y), copyLength * bytesPerPixel());
+    }
+
+    sideLength = newSideLength;
+    qSwap(image, newImage);
+    markAllDirty();
+    tiles.clear();
+    if (wasTiled) {
+        compact();
+    }
+}
+
+void Frame::fillSpan(int y, int x, int length, QColor color) {
+    fillRect(QRect(x, y, length, 1), color);
+}
+
+void Frame::blendSpan(int y, int x, int length, QColor color) {
+    if (isIndexed() || color.alpha() == 255) {
+        fillSpan(y, x, length, color);
+        return;
+    }
+
+    QRect clipped = QRect(x, y, length, 1).intersected(QRect(0, 0, sideLength, sideLength));
+    if (clipped.isEmpty() || color.alpha() == 0) {
+        return;
+    }
+
+    QRgb pixel = qPremultiply(color.rgba());
+    markDirty(clipped);
+    if (!isTiled()) {
+        blendPixels(reinterpret_cast<QRgb*>(pixelAddress(clipped.left(), y)), pixel, clipped.width());
+        return;
+    }
+
+    // Blend tile by tile, so only the tiles under the run are detached
+    for (int column = clipped.left(); column <= clipped.right(); column = (column / TILE_SIZE + 1) * TILE_SIZE) {
+        int end = std::min(clipped.right() + 1, (column / TILE_SIZE + 1) * TILE_SIZE);
+        blendPixels(reinterpret_cast<QRgb*>(pixelAddress(column, y)), pixel, end - column);
+    }
 }
 
-void Frame::resizePixmap(int newSideLength) {
-    QPixmap newPixmap(newSideLength, newSideLength);
-    newPixmap.fill(Qt::transparent);
-    QPainter painter(&newPixmap);
-    painter.drawPixmap(0, 0, pixmap);
-    qSwap(pixmap, newPixmap);
+void Frame::fillRect(const QRect& rect, QColor color) {
+    QRect clipped = rect.intersected(QRect(0, 0, sideLength, sideLength));
+    if (clipped.isEmpty()) {
+        return;
+    }
+
+    quint32 value = pixelValue(color);
+    int pixelBytes = bytesPerPixel();
+    markDirty(clipped);
+    for (int y = clipped.top(); y <= clipped.bottom(); y++) {
+        if (!isTiled()) {
+            fillPixels(pixelAddress(clipped.left(), y), value, clipped.width(), pixelBytes);
+            continue;
+        }
+
+        // Fill tile by tile, so only the tiles under the rectangle are detached
+        for (int x = clipped.left(); x <= clipped.right(); x = (x / TILE_SIZE + 1) * TILE_SIZE) {
+            int end = std::min(clipped.right() + 1, (x / TILE_SIZE + 1) * TILE_SIZE);
+            fillPixels(pixelAddress(x, y), value, end - x, pixelBytes);
+        }
+    }
 }
 
-void Frame::updatePixmap(QPoint pixelPos, QColor color) {
-    QPainter painter(&pixmap);
-    painter.setCompositionMode(QPainter::CompositionMode_Source);
-    painter.fillRect(pixelPos.x(), pixelPos.y(), 1, 1, color);
+void Frame::pastePixels(const QImage& pixels, const QImage& mask, QPoint position) {
+    QRect clipped = QRect(position, mask.size()).intersected(QRect(0, 0, sideLength, sideLength));
+    if (clipped.isEmpty()) {
+        return;
+    }
+
+    // Pasted pixels tend to repeat a few colors, so each one is only looked up in the table once
+    QHash<QRgb, uchar> indices;
+    markDirty(clipped);
+    for (int y = clipped.top(); y <= clipped.bottom(); y++) {
+        const uchar* maskRow = mask.constScanLine(y - position.y());
+        const QRgb* in = reinterpret_cast<const QRgb*>(pixels.constScanLine(y - position.y()));
+
+        int x = clipped.left();
+        while (x <= clipped.right()) {
+            if (maskRow[x - position.x()] == 0) {
+                x++;
+                continue;
+            }
+
+            // A run of set mask pixels, cut at tile edges so only the tiles under it are detached
+            int limit = clipped.right() + 1;
+            if (isTiled()) {
+                limit = std::min(limit, (x / TILE_SIZE + 1) * TILE_SIZE);
+            }
+            int end = x + 1;
+            while (end < limit && maskRow[end - position.x()] != 0) {
+                end++;
+            }
+
+            uchar* out = pixelAddress(x, y);
+            if (!isIndexed()) {
+                std::memcpy(out, in + x - position.x(), (end - x) * sizeof(QRgb));
+            } else {
+                for (int i = x; i < end; i++) {
+                    QRgb pixel = in[i - position.x()];
+                    auto index = indices.constFind(pixel);
+                    if (index == indices.constEnd()) {
+                        index = indices.insert(pixel, uchar(nearestIndex(colorTable, pixel)));
+                    }
+                    out[i - x] = *index;
+                }
+            }
+            x = end;
+        }
+    }
+}
+
+void Frame::applyBatch(const PaintBatch& batch) {
+    for (const PaintBatch::Span& span : batch.getSpans()) {
+        if (span.isBlended) {
+            blendSpan(span.y, span.x, span.length, span.color);
+        } else {
+            fillSpan(span.y, span.x, span.length, span.color);
+        }
+    }
 }
 
 void Frame::rotate(bool isClockwise) {
+    bool wasTiled = isTiled();
+    ensureDecoded();
     QTransform transform;
     transform.rotate(isClockwise ? 90 : -90);
-    pixmap = pixmap.transformed(transform);
+    image = image.transformed(transform);
+    markAllDirty();
+
+    tiles.clear();
+    if (wasTiled) {
+        compact();
+    }
 }
 
 void Frame::flip(bool isAlongXAxis) {
-    QTransform transform;
+    bool wasTiled = isTiled();
+    ensureDecoded();
+    // Flipping along the x-axis swaps the rows, flipping along the y-axis swaps the columns
+    image = image.mirrored(!isAlongXAxis, isAlongXAxis);
+    markAllDirty();
 
-    if (isAlongXAxis) {
-        transform.scale(1, -1);
-        transform.translate(0, -pixmap.height());
-    } else {
-        transform.scale(-1, 1);
-        transform.translate(-pixmap.width(), 0);
+    tiles.clear();
+    if (wasTiled) {
+        compact();
     }
-
-    pixmap = pixmap.transformed(transform);
 }
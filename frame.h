@@ -6,8 +6,18 @@
     Assignment - A8: Sprite Editor Implementation
 
     The Frame class serves as the model that stores the data of a frame in the sprite. It has provides some functions
-    that helps to manipulate the data. For example, export the data to json, rotate the frame by 90 degrees, paint at
-    a specified pixel, etc.
+    that helps to manipulate the data. For example, export the data to json, rotate the frame by 90 degrees, paint a
+    run of pixels, etc.
+
+    The pixels are kept in a contiguous premultiplied ARGB32 buffer on the CPU. Writes go straight to its scanlines
+    instead of through a QPainter, and since no QPixmap is involved a frame can be processed off the GUI thread.
+
+    Large frames that are not being edited can be compacted into square tiles. Fully transparent tiles are not
+    stored at all, and tiles are shared copy-on-write between copies of a frame, so duplicated or mostly empty
+    frames only cost the memory of the tiles that actually differ.
+
+    In indexed mode a frame stores one byte per pixel, indexing a color table that is only applied when the frame
+    is drawn. Swapping the table recolors the frame without touching its pixels.
 
     Code style checked by: Maxwell Rodgers
 */
@@ -15,18 +25,51 @@
 #ifndef FRAME_H
 #define FRAME_H
 
-#include <QPixmap>
-#include <QJsonArray>
+#include <QImage>
+#include <QRect>
+#include <QJsonObject>
 #include <QPoint>
 #include <QColor>
+#include <QList>
+#include <QSet>
+#include <vector>
+#include "paintbatch.h"
+#include "spritefile.h"
 
 class Frame
 {
 public:
-    /// \brief Frame Create a Frame where the pixmaps of background and foregound are empty.
-    /// \param sideLength The side length of the pixmaps.
+    /// \brief Snapshot The pixels of a frame at one point in time, safe to read from a worker thread. Exactly one of
+    /// the three is set: the image of a decoded frame (sharing its data copy-on-write), the tiles of a compacted
+    /// frame together with its color table, or the blob of a frame that was never decoded. An indexed image also
+    /// carries the color table when it has not taken it yet, see setColorTable.
+    struct Snapshot {
+        QImage image;
+        std::vector<QImage> tiles;
+        QList<QRgb> colorTable;
+        int sideLength = 0;
+        SpriteFile::EncodedFrame encoded;
+    };
+
+    /// \brief TILE_SIZE The side length of a tile of a compacted frame.
+    static const int TILE_SIZE = 64;
+
+    /// \brief MIN_TILED_SIDE_LENGTH Frames smaller than this stay in one buffer, where tiling would not save much.
+    static const int MIN_TILED_SIDE_LENGTH = 256;
+
+    /// \brief FORMAT The format of the pixel buffer of every frame.
+    static const QImage::Format FORMAT = QImage::Format_ARGB32_Premultiplied;
+
+    /// \brief Frame Create a Frame where every pixel is transparent.
+    /// \param sideLength The side length of the frame.
     Frame(int sideLength);
 
+    /// \brief Frame Create a Frame that only keeps the encoded pixels until they are first accessed, like
+    /// loadEncoded, without allocating a pixel buffer first.
+    /// \param sideLength The side length of the frame.
+    /// \param encoded The encoded pixels of the frame, as stored in a binary .sprite file.
+    Frame(int sideLength, const SpriteFile::EncodedFrame& encoded);
+
     /// \brief Frame Create a Frame by deep-copy from another Frame.
     /// \param other The other Frame to copy from.
     Frame(const Frame &other);
@@ -36,23 +79,166 @@ public:
     /// \return A deep-copy of the other Frame.
     Frame &operator=(Frame other);
 
-    /// \brief convertToJson Convert the foregroundPixmap of the frame into Json
-    /// which stores each pixel data of this frame.
-    /// \return A QJsonObject that holds the frame's Json data.
-    QJsonArray convertToJson();
+    /// \brief imageFromJson Decode the Json data of a frame into a QImage, accepting both the legacy per-pixel
+    /// schema and the row schema. Safe to call from a worker thread.
+    /// \param json A QJsonValue holding the data of one frame.
+    /// \param sideLength The side length of the frame.
+    /// \return A QImage holding the frame's pixels.
+    static QImage imageFromJson(const QJsonValue& json, int sideLength);
+
+    /// \brief imageToRowJson Encode the pixels of a frame into the compact row schema: one hex string per row,
+    /// using a palette of the frame's colors with one or two hex digits per pixel when there are at most 256
+    /// colors, and eight digits (AARRGGBB) per pixel otherwise. Safe to call from a worker thread.
+    /// \param image The pixels of the frame.
+    /// \return The Json object of the frame as text, with every row on its own line.
+    static QByteArray imageToRowJson(const QImage& image);
+
+    /// \brief toImage Get the pixels of the frame as a QImage sharing the buffer copy-on-write, which stays
+    /// unchanged when the frame is painted on afterwards. Indexed frames are converted to colors first.
+    /// \return A QImage holding the frame's pixels, in FORMAT.
+    QImage toImage() const;
+
+    /// \brief loadFromImage Override the pixels of the frame with the pixels of a QImage. A null image leaves the
+    /// frame transparent.
+    /// \param image The image whose pixels will be used to override.
+    void loadFromImage(const QImage& image);
+
+    /// \brief loadEncoded Defer loading the frame until its pixels are first accessed. Until then only the
+    /// encoded blob is kept, which may point straight into a memory-mapped file.
+    /// \param frame The encoded pixels of the frame, as stored in a binary .sprite file.
+    void loadEncoded(const SpriteFile::EncodedFrame& frame);
+
+    /// \brief encode Pack the pixels of the frame for the binary format. A frame that was never decoded
+    /// hands back its blob untouched.
+    /// \return The encoded pixels of the frame.
+    SpriteFile::EncodedFrame encode() const;
+
+    /// \brief snapshot Capture the pixels of the frame for a worker thread. Only copies references, no pixels.
+    /// \return The snapshot.
+    Snapshot snapshot() const;
+
+    /// \brief encodeSnapshot Pack a snapshot for the binary format, passing a blob through untouched.
+    /// Safe to call from a worker thread.
+    /// \param snapshot The snapshot.
+    /// \return The encoded pixels.
+    static SpriteFile::EncodedFrame encodeSnapshot(const Snapshot& snapshot);
+
+    /// \brief encodeJournalSnapshot Pack a snapshot for the autosave journal. Unlike encodeSnapshot, an indexed
+    /// frame keeps its palette indices, so a palette change does not have to journal the frame again.
+    /// Safe to call from a worker thread.
+    /// \param snapshot The snapshot.
+    /// \return The encoded pixels.
+    static SpriteFile::EncodedFrame encodeJournalSnapshot(const Snapshot& snapshot);
+
+    /// \brief decodeSnapshot Get the pixels of a snapshot, decoding its blob if needed.
+    /// Safe to call from a worker thread.
+    /// \param snapshot The snapshot.
+    /// \param sideLength The side length of the frame.
+    /// \return The pixels.
+    static QImage decodeSnapshot(const Snapshot& snapshot, int sideLength);
+
+    /// \brief loadDecoded Hand a still-encoded frame the pixels that were decoded from its blob elsewhere,
+    /// e.g. on a worker thread. Does nothing if the frame was decoded in the meantime.
+    /// \param image The decoded pixels of the frame.
+    void loadDecoded(const QImage& image);
+
+    /// \brief loadIndices Override the pixels of the frame with palette indices, as recovered from the autosave
+    /// journal. The frame becomes transparent if the indices are null or there is no color table.
+    /// \param indices The palette indices, in Format_Indexed8, see SpriteFile::decodeIndices.
+    /// \param colorTable The colors the indices point to, as non-premultiplied ARGB.
+    void loadIndices(const QImage& indices, const QList<QRgb>& colorTable);
+
+    /// \brief isDecoded Check if the pixels of the frame are in memory, or still only encoded.
+    /// \return True if accessing the pixels will not trigger a decode.
+    bool isDecoded() const;
+
+    /// \brief detachEncoded Deep-copy a pending blob, so the file it points into can be unmapped or overwritten.
+    void detachEncoded();
+
+    /// \brief compact Move the pixels of a frame that is not being edited into tiles, dropping the one large
+    /// buffer. Tiles that did not change since the frame was last compacted stay shared. Does nothing for frames
+    /// smaller than MIN_TILED_SIDE_LENGTH and for frames that are still encoded.
+    void compact();
+
+    /// \brief isTiled Check if the frame is compacted into tiles.
+    /// \return True if accessing the pixel buffer will first assemble it from the tiles.
+    bool isTiled() const;
+
+    /// \brief toIndexed Switch the frame to indexed storage with one byte per pixel. Lossless as long as every
+    /// color of the frame is in the table, other colors take the nearest entry.
+    /// \param colorTable The colors as non-premultiplied ARGB, where index 0 has to be transparent.
+    void toIndexed(const QList<QRgb>& colorTable);
+
+    /// \brief toArgb Switch an indexed frame back to storing the color of every pixel. Lossless.
+    void toArgb();
+
+    /// \brief isIndexed Check if the frame stores palette indices instead of colors.
+    bool isIndexed() const;
+
+    /// \brief setColorTable Replace the color table of an indexed frame, without touching its pixels. A pixel buffer
+    /// shared with a copy or a snapshot of the frame only takes the table once it is accessed, so it is not copied
+    /// just to be recolored.
+    /// \param colorTable The new colors, as non-premultiplied ARGB.
+    void setColorTable(const QList<QRgb>& colorTable);
 
-    /// \brief loadFromJson Using data from a QJsonObject to override the foregroundPixmap.
-    /// \param json A QJsonValue from where the data will be used to override.
-    void loadFromJson(QJsonValue json);
+    /// \brief collectColors Gather the distinct premultiplied colors the frame uses.
+    /// \param colors Receives the colors.
+    /// \param maxColors The amount of colors after which collecting stops.
+    /// \return False if there were more than maxColors colors.
+    bool collectColors(QSet<QRgb>& colors, int maxColors) const;
 
-    /// \brief resizePixmap Resize the pixmap according to the new side length of pixel size.
+    /// \brief takeDirtyRect Get the part of the frame that was modified since the last call, and start over.
+    /// \return The modified rectangle in canvas pixels, empty if nothing changed.
+    QRect takeDirtyRect();
+
+    /// \brief thumbnail Scale the frame down for a preview with nearest neighbour sampling. A compacted frame is
+    /// sampled straight from its tiles, without assembling its pixel buffer.
+    /// \param size The side length of the thumbnail.
+    /// \return The thumbnail.
+    QImage thumbnail(int size) const;
+
+    /// \brief getSideLength Returns the side length of the frame, in pixels.
+    int getSideLength() const;
+
+    /// \brief getImage Get the pixel buffer of the frame for display, decoding it first if needed.
+    /// \return The pixels of the frame, in FORMAT, or in Format_Indexed8 with the color table for an indexed frame.
+    const QImage& getImage() const;
+
+    /// \brief resize Resize the frame to a new side length, keeping the pixels at the top left.
     /// \param newSideLength The new amount of canvas pixels on each axis.
-    void resizePixmap(int newSideLength);
+    void resize(int newSideLength);
+
+    /// \brief fillSpan Set the color of a horizontal run of pixels, clipped to the frame.
+    /// \param y The row of the run.
+    /// \param x The first column of the run.
+    /// \param length The amount of pixels in the run.
+    /// \param color The new color of the run.
+    void fillSpan(int y, int x, int length, QColor color);
+
+    /// \brief blendSpan Paint a color over a horizontal run of pixels with source-over blending, clipped to the
+    /// frame. An indexed frame cannot hold the blended colors, so it takes the color as fillSpan does.
+    /// \param y The row of the run.
+    /// \param x The first column of the run.
+    /// \param length The amount of pixels in the run.
+    /// \param color The color to blend over the run.
+    void blendSpan(int y, int x, int length, QColor color);
+
+    /// \brief fillRect Set the color of a rectangle of pixels, clipped to the frame.
+    /// \param rect The rectangle in canvas pixels.
+    /// \param color The new color of the rectangle.
+    void fillRect(const QRect& rect, QColor color);
 
-    /// \brief updatePixmap Update the color of the pixmap at a specified canvas pixel position.
-    /// \param pixelPos The canvas pixel position where the color will be updated.
-    /// \param color The new color to have at pixelPos
-    void updatePixmap(QPoint pixelPos, QColor color);
+    /// \brief pastePixels Copy pixels into the frame wherever a mask is set, clipped to the frame. The runs of set
+    /// mask pixels are copied a row at a time. An indexed frame takes the nearest colors of its table.
+    /// \param pixels The pixels to paste, in FORMAT.
+    /// \param mask Where to paste, in Format_Alpha8 with the size of pixels, non-zero where a pixel is copied.
+    /// \param position Where the top left corner of pixels goes, in canvas pixels.
+    void pastePixels(const QImage& pixels, const QImage& mask, QPoint position);
+
+    /// \brief applyBatch Paint every span of a batch in order, clipped to the frame, blending the spans that ask
+    /// for it.
+    /// \param batch The spans to paint.
+    void applyBatch(const PaintBatch& batch);
 
     /// \brief rotate Rotate the painting(frame) by 90 degrees.
     /// \param isClockwise If this rotation is clockwise or counter clockwise.
@@ -62,12 +248,77 @@ public:
     /// \param isAlongXAxis If this flip is along the x-axis or the y-axis.
     void flip(bool isAlongXAxis);
 
-    /// \brief pixmap The QPixmap where the painting is stored. This will be what the user paints.
-    QPixmap pixmap;
-
 private:
+    /// \brief imageFromRowJson Decode a frame stored in the compact row schema, see imageToRowJson.
+    /// \param json The Json object of the frame.
+    /// \param sideLength The side length of the frame.
+    /// \return A QImage holding the frame's pixels.
+    static QImage imageFromRowJson(const QJsonObject& json, int sideLength);
+
+    /// \brief image The pixel buffer where the painting is stored. This will be what the user paints.
+    /// Null while the frame is still only encoded or compacted into tiles.
+    mutable QImage image;
+
+    /// \brief tiles The tiles of a compacted frame, row by row, where a null tile is fully transparent. Kept
+    /// after the pixel buffer is assembled from them, so compact can reuse the tiles that did not change.
+    mutable std::vector<QImage> tiles;
+
+    /// \brief colorTable The colors the pixels of an indexed frame point to. Empty unless the frame is indexed.
+    QList<QRgb> colorTable;
+
+    /// \brief isColorTableStale True while the pixel buffer of an indexed frame still holds an older color table.
+    mutable bool isColorTableStale = false;
+
+    /// \brief dirtyRect The part of the frame that was modified since the last call to takeDirtyRect.
+    QRect dirtyRect;
+
+    /// \brief markDirty Add a modified rectangle to dirtyRect.
+    /// \param rect The rectangle in canvas pixels.
+    void markDirty(const QRect& rect);
+
+    /// \brief markAllDirty Mark the whole frame as modified.
+    void markAllDirty();
+
+    /// \brief encoded The encoded pixels of a frame that has not been decoded yet.
+    mutable SpriteFile::EncodedFrame encoded;
+
     /// \brief sideLength The amount of canvas pixel on each axis.
     int sideLength;
+
+    /// \brief ensureDecoded Decode the pending blob or assemble the tiles into the pixel buffer, if needed.
+    void ensureDecoded() const;
+
+    /// \brief pixelAddress Get write access to one pixel, detaching only its tile if the frame is compacted.
+    /// \param x The column of the pixel, which must lie inside the frame.
+    /// \param y The row of the pixel, which must lie inside the frame.
+    /// \return The pixel, bytesPerPixel bytes long.
+    uchar* pixelAddress(int x, int y);
+
+    /// \brief bytesPerPixel Returns 1 for an indexed frame, 4 otherwise.
+    int bytesPerPixel() const;
+
+    /// \brief pixelValue Returns what to store for a color: its premultiplied value, or its index in the table.
+    quint32 pixelValue(QColor color) const;
+
+    /// \brief fillPixels Store the same value into a run of pixels.
+    static void fillPixels(uchar* out, quint32 value, int count, int bytesPerPixel);
+
+    /// \brief blendPixels Blend a premultiplied color over a run of premultiplied pixels (source-over). Four
+    /// pixels are blended at a time where SSE2 is available.
+    static void blendPixels(QRgb* out, QRgb color, int count);
+
+    /// \brief nearestIndex Find the entry of a color table closest to a premultiplied color.
+    static int nearestIndex(const QList<QRgb>& colorTable, QRgb pixel);
+
+    /// \brief tilesPerSide Returns the amount of tiles on each axis of a frame.
+    static int tilesPerSide(int sideLength);
+
+    /// \brief assembleTiles Copy tiles into one pixel buffer. Safe to call from a worker thread.
+    /// \param tiles The tiles, row by row.
+    /// \param sideLength The side length of the frame.
+    /// \param colorTable The color table of an indexed frame, empty otherwise.
+    /// \return The pixels of the frame.
+    static QImage assembleTiles(const std::vector<QImage>& tiles, int sideLength, const QList<QRgb>& colorTable);
 };
 
 #endif // FRAME_H
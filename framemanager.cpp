@@ -11,6 +11,8 @@
 */
 
 #include "framemanager.h"
+#include "spritefile.h"
+#include "autosavejournal.h"
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QJsonObject>
@@ -18,59 +20,364 @@
 #include <QIODevice>
 #include <QTextStream>
 #include <QByteArray>
+#include <QDebug>
+#include <QFileInfo>
+#include <QHash>
+#include <QSet>
+#include <QEventLoop>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtConcurrent>
+#include <algorithm>
+#include <atomic>
 
 FrameManager::FrameManager(int sideLength, int fps, QObject *parent)
-    : QObject{parent}, selectedFrameIndex(-1), sideLength(sideLength), fps(fps) {
+    : QObject{parent}, selectedFrameIndex(-1), sideLength(sideLength), fps(fps),
+    journal(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/autosave.journal") {
     connect(&animationTimer, &QTimer::timeout, this, &FrameManager::onUpdatePreview);
     animationTimer.start(1000 / fps);
+
+    connect(&saveWatcher, &QFutureWatcherBase::finished, this, &FrameManager::onSaveFinished);
+    connect(&saveWatcher, &QFutureWatcherBase::progressValueChanged, this, [this](int value) {
+        emit fileProgress(value, saveWatcher.progressMaximum());
+    });
+    connect(&autosaveTimer, &QTimer::timeout, this, &FrameManager::onAutosave);
+    connect(&journalWatcher, &QFutureWatcherBase::finished, this, [this]() {
+        if (isWritingCheckpoint) {
+            journal.checkpointWritten(journalWatcher.result());
+        } else {
+            if (journalWatcher.result() < 0) {
+                qWarning() << "Could not append to the autosave journal" << journal.getFilePath();
+            }
+            journal.appendWritten(journalWatcher.result());
+        }
+        deleteRetiredFiles();
+    });
+    connect(&prefetchWatcher, &QFutureWatcherBase::resultReadyAt, this, &FrameManager::onPrefetchResultReady);
+    connect(&prefetchWatcher, &QFutureWatcherBase::progressValueChanged, this, [this](int value) {
+        emit fileProgress(value, prefetchWatcher.progressMaximum());
+    });
+
+    if (!journal.acquire()) {
+        qWarning() << "Another instance of the editor is autosaving into" << journal.getFilePath()
+                   << "so this one will not autosave";
+    }
+}
+
+FrameManager::~FrameManager() {
+    // Let the running and requested saves complete, quitting should not lose them
+    saveWatcher.waitForFinished();
+    if (hasPendingSave) {
+        hasPendingSave = false;
+        startSave(pendingSave);
+        saveWatcher.waitForFinished();
+    }
+    journalWatcher.waitForFinished();
+    deleteRetiredFiles();
+
+    // The editor exits cleanly, so there is nothing to recover next time
+    journal.discard();
+
+    deleteFrames(takeFrames());
+    releaseMappedFile();
 }
 
 void FrameManager::onSetSideLength(int length) {
+    beginUpdate();
     sideLength = length;
-    for (Frame* frame : frames) {
-        frame->resizePixmap(sideLength);
+    for (Frame* frame : distinctFrames()) {
+        frame->resize(sideLength);
+        journal.markFrameChanged(frame);
     }
+    journal.markLayoutChanged();
     emit sideLengthChanged(sideLength);
+    emitSelectedFrameRegion();
+
+    // Every thumbnail is cropped or padded along with its frame
+    if (!frames.empty()) {
+        notifyFramesChanged();
+    }
+    endUpdate();
 }
 
 void FrameManager::selectFrame(int frameIndex) {
+    if (updateDepth > 0) {
+        if (frameIndex >= 0 && frameIndex < int(frames.size())) {
+            selectedFrameIndex = frameIndex;
+        }
+        isSelectionChangePending = true;
+        return;
+    }
+
     if (frameIndex >= 0 && frameIndex < int(frames.size())) {
         selectedFrameIndex = frameIndex;
+        // The whole frame gets drawn anyway, so what changed while it was not selected no longer matters
+        getSelectedFrame()->takeDirtyRect();
         emit selectedFrameChanged(getSelectedFrame());
+        compactIdleFrames();
     }
     emit frameSelected(selectedFrameIndex);
 }
 
+void FrameManager::onIndexedModeSet(bool enabled) {
+    if (enabled == !palette.isEmpty()) {
+        return;
+    }
+
+    std::vector<Frame*> uniqueFrames = distinctFrames();
+    if (enabled) {
+        QSet<QRgb> colors;
+        colors.insert(0);
+        for (Frame* frame : uniqueFrames) {
+            if (!frame->collectColors(colors, MAX_PALETTE_SIZE)) {
+                qWarning() << "The sprite uses more than" << MAX_PALETTE_SIZE << "colors and cannot be indexed";
+                emit paletteChanged(palette);
+                return;
+            }
+        }
+
+        // Transparent goes first, so a fully transparent tile of an indexed frame is all zero bytes
+        QList<QRgb> sortedColors(colors.begin(), colors.end());
+        std::sort(sortedColors.begin(), sortedColors.end());
+        for (QRgb color : sortedColors) {
+            palette.append(qUnpremultiply(color));
+        }
+
+        for (Frame* frame : uniqueFrames) {
+            frame->toIndexed(palette);
+        }
+    } else {
+        for (Frame* frame : uniqueFrames) {
+            frame->toArgb();
+        }
+        palette.clear();
+    }
+
+    // The journal keeps indexed frames as indices, so it starts over with a checkpoint in the new storage
+    journal.markPaletteChanged(palette);
+    journal.requestCheckpoint();
+    emit paletteChanged(palette);
+    emitSelectedFrameReset();
+    notifyFramesChanged();
+}
+
+void FrameManager::onPaletteColorSet(int index, QColor color) {
+    if (index <= 0 || index >= palette.size()) {
+        return;
+    }
+
+    // The journal keeps the indices of indexed frames, so only the palette is new to it
+    palette[index] = color.rgba();
+    for (Frame* frame : distinctFrames()) {
+        frame->setColorTable(palette);
+    }
+    journal.markPaletteChanged(palette);
+    refreshSelectedColorTable();
+
+    emit paletteChanged(palette);
+    emitSelectedFrameRegion();
+    notifyFramesChanged();
+}
+
+void FrameManager::addPaletteColor(QColor color) {
+    QRgb pixel = qPremultiply(color.rgba());
+    bool isInPalette = std::any_of(palette.begin(), palette.end(), [pixel](QRgb entry) {
+        return qPremultiply(entry) == pixel;
+    });
+    if (isInPalette || palette.size() >= MAX_PALETTE_SIZE) {
+        return;
+    }
+
+    palette.append(color.rgba());
+    for (Frame* frame : distinctFrames()) {
+        frame->setColorTable(palette);
+    }
+    journal.markPaletteChanged(palette);
+    refreshSelectedColorTable();
+    emit paletteChanged(palette);
+}
+
+void FrameManager::refreshSelectedColorTable() {
+    // The canvas draws straight from the pixel buffer of the selected frame, so it has to take the new table now
+    // rather than whenever its pixels are next accessed
+    Frame* selectedFrame = getSelectedFrame();
+    if (selectedFrame != nullptr) {
+        selectedFrame->getImage();
+    }
+}
+
+std::vector<Frame*> FrameManager::distinctFrames() const {
+    std::vector<Frame*> uniqueFrames;
+    QSet<Frame*> seenFrames;
+    for (Frame* frame : frames) {
+        if (!seenFrames.contains(frame)) {
+            seenFrames.insert(frame);
+            uniqueFrames.push_back(frame);
+        }
+    }
+    return uniqueFrames;
+}
+
+void FrameManager::emitSelectedFrameRegion() {
+    // The frame keeps collecting its dirty rectangle until the transaction ends
+    Frame* selectedFrame = getSelectedFrame();
+    if (selectedFrame == nullptr || updateDepth > 0) {
+        return;
+    }
+
+    QRect region = selectedFrame->takeDirtyRect();
+    if (!region.isEmpty()) {
+        emit selectedFrameRegionChanged(region);
+        emit frameModified(selectedFrame, region);
+    }
+}
+
+void FrameManager::emitSelectedFrameReset() {
+    Frame* selectedFrame = getSelectedFrame();
+    if (selectedFrame == nullptr) {
+        return;
+    }
+
+    // The canvas starts over as if the frame was selected again, instead of replaying its stroke history over pixels
+    // that moved or changed storage
+    if (updateDepth > 0) {
+        isSelectionChangePending = true;
+        return;
+    }
+    emit selectedFrameChanged(selectedFrame);
+    emitSelectedFrameRegion();
+}
+
+void FrameManager::beginUpdate() {
+    updateDepth++;
+}
+
+void FrameManager::endUpdate() {
+    if (updateDepth == 0) {
+        qWarning() << "endUpdate was called without a matching beginUpdate";
+        return;
+    }
+    if (--updateDepth > 0) {
+        return;
+    }
+
+    // Same order as outside a transaction: the previews exist before one of them is selected
+    if (isFrameCountChangePending) {
+        isFrameCountChangePending = false;
+        emit frameCountChanged(frames.size());
+    }
+    if (isFramesChangePending) {
+        isFramesChangePending = false;
+        emit framesChanged(getFrames());
+    }
+    if (isSelectionChangePending) {
+        isSelectionChangePending = false;
+        selectFrame(selectedFrameIndex);
+    } else {
+        emitSelectedFrameRegion();
+    }
+}
+
+void FrameManager::notifyFrameCountChanged() {
+    if (updateDepth > 0) {
+        isFrameCountChangePending = true;
+    } else {
+        emit frameCountChanged(frames.size());
+    }
+}
+
+void FrameManager::notifyFramesChanged() {
+    if (updateDepth > 0) {
+        isFramesChangePending = true;
+    } else {
+        emit framesChanged(getFrames());
+    }
+}
+
+void FrameManager::compactIdleFrames() {
+    Frame* selectedFrame = getSelectedFrame();
+    for (Frame* frame : frames) {
+        if (frame != selectedFrame) {
+            frame->compact();
+        }
+    }
+}
+
 void FrameManager::onFrameAdded() {
     Frame* newFrame = new Frame(sideLength);
+    if (!palette.isEmpty()) {
+        newFrame->toIndexed(palette);
+    }
 
     // Add the newly created Frame object to the vector
     frames.push_back(newFrame);
+    journal.markFrameChanged(newFrame);
+    journal.markLayoutChanged();
     if (selectedFrameIndex == -1) {
         selectFrame(0); // Select the first frame by default
     }
 
-    emit frameCountChanged(frames.size());
-    emit framesChanged(getFrames());
+    notifyFrameCountChanged();
+    notifyFramesChanged();
     selectFrame(frames.size() - 1);
 }
 
 void FrameManager::removeFrame(int frameIndex) {
     if (frameIndex >= 0 && frameIndex < int(frames.size())) {
+        Frame* removedFrame = frames[frameIndex];
         frames.erase(frames.begin() + frameIndex);
         // If the selected frame is removed, select the previous one or the first
         if (selectedFrameIndex >= int(frames.size())) {
             selectFrame(frames.size() - 1);
         }
+        journal.markLayoutChanged();
+
+        // A linked frame lives on as long as one of its links is still in the timeline
+        if (std::find(frames.begin(), frames.end(), removedFrame) == frames.end()) {
+            std::replace(prefetchFrames.begin(), prefetchFrames.end(), removedFrame, static_cast<Frame*>(nullptr));
+            journal.forgetFrame(removedFrame);
+            delete removedFrame;
+        }
+    }
+}
+
+void FrameManager::onFrameLinked() {
+    Frame* selectedFrame = getSelectedFrame();
+    if (selectedFrame == nullptr) {
+        return;
+    }
+
+    // The link is the same frame once more, so painting on any of them paints on all of them
+    frames.insert(frames.begin() + selectedFrameIndex + 1, selectedFrame);
+    journal.markLayoutChanged();
+
+    notifyFrameCountChanged();
+    notifyFramesChanged();
+    selectFrame(selectedFrameIndex + 1);
+}
+
+void FrameManager::onFrameUnlinked() {
+    Frame* selectedFrame = getSelectedFrame();
+    if (selectedFrame == nullptr || std::count(frames.begin(), frames.end(), selectedFrame) < 2) {
+        return;
     }
+
+    // The copy shares its pixels copy-on-write until either side is painted on
+    Frame* unlinkedFrame = new Frame(*selectedFrame);
+    frames[selectedFrameIndex] = unlinkedFrame;
+    journal.markFrameChanged(unlinkedFrame);
+    journal.markLayoutChanged();
+
+    notifyFramesChanged();
+    selectFrame(selectedFrameIndex);
 }
 
 void FrameManager::onFrameRemove() {
     if (frames.size() != 1) {
         removeFrame(selectedFrameIndex);
-        emit frameCountChanged(frames.size());
+        notifyFrameCountChanged();
         emit selectedFrameChanged(getSelectedFrame());
-        emit framesChanged(getFrames());
+        notifyFramesChanged();
     }
 }
 
@@ -78,6 +385,7 @@ void FrameManager::setFrameIndex(int frameIndex, int newIndex) {
     if (frameIndex >= 0 && frameIndex < int(frames.size()) && newIndex >= 0 && newIndex < int(frames.size())) {
         // Swap the frames
         std::swap(frames[frameIndex], frames[newIndex]);
+        journal.markLayoutChanged();
 
         if (selectedFrameIndex == frameIndex) {
             selectedFrameIndex = newIndex;
@@ -100,9 +408,39 @@ std::vector<Frame*>& FrameManager::getFrames() {
     return frames;
 }
 
-void FrameManager::onPainted(QPoint pixelPos, QColor color) {
-    getSelectedFrame()->updatePixmap(pixelPos, color);
-    emit framesChanged(getFrames());
+void FrameManager::onPaintBatch(const PaintBatch& batch) {
+    if (!palette.isEmpty()) {
+        // A batch rarely holds more than a couple of colors, so each one is only looked up once
+        QSet<QRgb> batchColors;
+        for (const PaintBatch::Span& span : batch.getSpans()) {
+            if (!batchColors.contains(span.color.rgba())) {
+                batchColors.insert(span.color.rgba());
+                addPaletteColor(span.color);
+            }
+        }
+    }
+    getSelectedFrame()->applyBatch(batch);
+    journal.markFrameChanged(getSelectedFrame());
+    emitSelectedFrameRegion();
+}
+
+void FrameManager::onPastePixels(const QImage& pixels, const QImage& mask, QPoint position) {
+    if (!palette.isEmpty()) {
+        QSet<QRgb> pastedColors;
+        for (int y = 0; y < mask.height(); y++) {
+            const uchar* maskRow = mask.constScanLine(y);
+            const QRgb* row = reinterpret_cast<const QRgb*>(pixels.constScanLine(y));
+            for (int x = 0; x < mask.width(); x++) {
+                if (maskRow[x] != 0 && !pastedColors.contains(row[x])) {
+                    pastedColors.insert(row[x]);
+                    addPaletteColor(QColor::fromRgba(qUnpremultiply(row[x])));
+                }
+            }
+        }
+    }
+    getSelectedFrame()->pastePixels(pixels, mask, position);
+    journal.markFrameChanged(getSelectedFrame());
+    emitSelectedFrameRegion();
 }
 
 void FrameManager::onFrameSelect(int frameIndex) {
@@ -128,29 +466,236 @@ void FrameManager::onUpdatePreview() {
 }
 
 void FrameManager::onSaveFile() {
+    QString selectedFilter;
     QString filePath = QFileDialog::getSaveFileName(
         nullptr,
         "Save File",
         QDir::homePath(),
-        "Sprite Files (*.sprite);;All Files (*)");
+        "Sprite Files (*.sprite);;Sprite JSON Files (*.json);;All Files (*)",
+        &selectedFilter);
 
-    QFile file(filePath);
-    file.open(QIODevice::WriteOnly | QIODevice::Text);
+    if (filePath.isEmpty()) {
+        return;
+    }
 
-    QTextStream out(&file);
+    bool isJson = filePath.endsWith(".json", Qt::CaseInsensitive) || selectedFilter.startsWith("Sprite JSON");
 
-    QJsonArray framesJsonArray;
-    for (Frame* frame : frames) {
-        framesJsonArray.append(frame->convertToJson());
+    // Overwriting the mapped file would pull the pending blobs out from under the frames
+    if (mappedFile != nullptr && QFileInfo(filePath) == QFileInfo(mappedFile->fileName())) {
+        for (Frame* frame : frames) {
+            frame->detachEncoded();
+        }
+        releaseMappedFile();
     }
 
-    QJsonObject finalJson;
-    finalJson["sideLength"] = sideLength;
-    finalJson["frames"] = framesJsonArray;
+    SaveSnapshot snapshot = takeSnapshot(filePath, isJson);
+    if (saveWatcher.isRunning()) {
+        pendingSave = snapshot;
+        hasPendingSave = true;
+        return;
+    }
 
-    out << QJsonDocument(finalJson).toJson(QJsonDocument::Indented);
+    startSave(snapshot);
+}
 
-    file.close();
+FrameManager::SaveSnapshot FrameManager::takeSnapshot(const QString& filePath, bool isJson) {
+    SaveSnapshot snapshot;
+    snapshot.filePath = filePath;
+    snapshot.isJson = isJson;
+    snapshot.sideLength = sideLength;
+    snapshot.frames.resize(frames.size());
+    snapshot.links.assign(frames.size(), -1);
+
+    // Only the first appearance of a linked frame is captured, the others just point back to it
+    QHash<const Frame*, int> firstIndices;
+    for (size_t i = 0; i < frames.size(); i++) {
+        if (firstIndices.contains(frames[i])) {
+            snapshot.links[i] = firstIndices.value(frames[i]);
+        } else {
+            firstIndices.insert(frames[i], int(i));
+            snapshot.frames[i] = frames[i]->snapshot();
+        }
+    }
+
+    return snapshot;
+}
+
+void FrameManager::startSave(const SaveSnapshot& snapshot) {
+    saveFilePath = snapshot.filePath;
+    saveWatcher.setFuture(QtConcurrent::run(&FrameManager::writeSnapshot, snapshot));
+}
+
+void FrameManager::writeSnapshot(QPromise<QString>& promise, const SaveSnapshot& snapshot) {
+    int frameSideLength = snapshot.sideLength;
+    std::atomic<int> encodedCount(0);
+    promise.setProgressRange(0, snapshot.frames.size());
+
+    QByteArray data;
+    if (snapshot.isJson) {
+        // Frames that were never decoded have to be decoded here, they are needed as pixels
+        QList<QByteArray> frameJsons = QtConcurrent::blockingMapped<QList<QByteArray>>(
+            snapshot.frames,
+            [&promise, &encodedCount, frameSideLength](const Frame::Snapshot& frame) {
+                QByteArray json = Frame::imageToRowJson(Frame::decodeSnapshot(frame, frameSideLength));
+                promise.setProgressValue(++encodedCount);
+                return json;
+            });
+        for (size_t i = 0; i < snapshot.links.size(); i++) {
+            if (snapshot.links[i] >= 0) {
+                frameJsons[i] = "{\"link\":" + QByteArray::number(snapshot.links[i]) + "}";
+            }
+        }
+
+        // The document is assembled by hand so every row lands on its own line, while staying valid JSON
+        data = "{\"format\":\"sprite-rows\",\"version\":1,\"sideLength\":" + QByteArray::number(frameSideLength) + ",\"frames\":[\n";
+        data += frameJsons.join(",\n");
+        data += "\n]}\n";
+    } else {
+        std::vector<SpriteFile::EncodedFrame> encodedFrames = QtConcurrent::blockingMapped<std::vector<SpriteFile::EncodedFrame>>(
+            snapshot.frames,
+            [&promise, &encodedCount](const Frame::Snapshot& frame) {
+                SpriteFile::EncodedFrame encoded = Frame::encodeSnapshot(frame);
+                promise.setProgressValue(++encodedCount);
+                return encoded;
+            });
+        for (size_t i = 0; i < snapshot.links.size(); i++) {
+            if (snapshot.links[i] >= 0) {
+                encodedFrames[i] = SpriteFile::linkTo(snapshot.links[i]);
+            }
+        }
+
+        data = SpriteFile::write(frameSideLength, encodedFrames);
+    }
+
+    // QSaveFile writes to a temporary file and renames it over the target on commit, so a failed or
+    // interrupted save never leaves a half-written project behind
+    QSaveFile file(snapshot.filePath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        promise.addResult(file.errorString());
+        return;
+    }
+
+    promise.addResult(QString());
+}
+
+void FrameManager::onSaveFinished() {
+    QString error = saveWatcher.result();
+    if (error.isEmpty()) {
+        emit fileSaved(saveFilePath);
+    } else {
+        qWarning() << "Could not save" << saveFilePath << ":" << error;
+        emit fileSaveFailed(saveFilePath, error);
+    }
+
+    if (hasPendingSave) {
+        hasPendingSave = false;
+        startSave(pendingSave);
+        pendingSave = SaveSnapshot();
+        return;
+    }
+
+    deleteRetiredFiles();
+}
+
+void FrameManager::deleteRetiredFiles() {
+    if (saveWatcher.isRunning() || hasPendingSave || journalWatcher.isRunning()) {
+        return;
+    }
+
+    for (const std::pair<QFile*, QByteArray>& retiredFile : retiredFiles) {
+        delete retiredFile.first;
+    }
+    retiredFiles.clear();
+}
+
+bool FrameManager::hasAutosaveJournal() const {
+    // The journal of an instance that is still running is not left behind
+    return journal.isAcquired() && journal.exists();
+}
+
+bool FrameManager::recoverAutosave() {
+    int recoveredSideLength;
+    std::vector<SpriteFile::EncodedFrame> recoveredFrames;
+    QList<QRgb> recoveredPalette;
+    if (!journal.recover(recoveredSideLength, recoveredFrames, recoveredPalette) || recoveredFrames.empty()) {
+        qWarning() << "The autosave journal could not be recovered";
+        return false;
+    }
+
+    beginUpdate();
+    std::vector<Frame*> oldFrames = takeFrames();
+
+    if (sideLength != recoveredSideLength) {
+        onSetSideLength(recoveredSideLength);
+    }
+
+    addEncodedFrames(recoveredFrames);
+
+    // Indexed frames were journaled as palette indices, which only get their colors from the recovered palette
+    palette = recoveredPalette;
+    for (size_t i = 0; i < recoveredFrames.size(); i++) {
+        if (recoveredFrames[i].encoding == SpriteFile::INDEXED) {
+            frames[i]->loadIndices(SpriteFile::decodeIndices(recoveredFrames[i], sideLength), palette);
+        }
+    }
+    if (!palette.isEmpty()) {
+        for (Frame* frame : distinctFrames()) {
+            if (!frame->isIndexed()) {
+                frame->toIndexed(palette);
+            }
+        }
+    }
+    emit paletteChanged(palette);
+
+    notifyFrameCountChanged();
+    notifyFramesChanged();
+    selectFrame(frames.size() - 1);
+    endUpdate();
+
+    deleteFrames(oldFrames);
+    releaseMappedFile();
+
+    // The recovered frames are new objects, so the journal starts over with a checkpoint of them. The old journal
+    // is kept until that checkpoint replaces it.
+    journal.reset();
+    journal.markPaletteChanged(palette);
+
+    startPrefetch();
+
+    emit fileLoaded();
+    return true;
+}
+
+void FrameManager::discardAutosave() {
+    journal.discard();
+}
+
+void FrameManager::startAutosave() {
+    if (!journal.isAcquired()) {
+        return;
+    }
+    onAutosave();
+    autosaveTimer.start(AUTOSAVE_INTERVAL_MS);
+}
+
+void FrameManager::onAutosave() {
+    // Changes made while the journal is written stay marked and are appended after it
+    if (journalWatcher.isRunning()) {
+        return;
+    }
+
+    // Encoding the frames is left to a worker thread, like for saving, so the event loop keeps its refresh rate
+    if (journal.needsCheckpoint()) {
+        isWritingCheckpoint = true;
+        journalWatcher.setFuture(QtConcurrent::run(&AutosaveJournal::writeCheckpoint,
+                                                   journal.getFilePath(),
+                                                   journal.takeCheckpoint(sideLength, frames)));
+    } else if (journal.hasChanges()) {
+        isWritingCheckpoint = false;
+        journalWatcher.setFuture(QtConcurrent::run(&AutosaveJournal::writeAppend,
+                                                   journal.getFilePath(),
+                                                   journal.takeAppend(sideLength, frames)));
+    }
 }
 
 void FrameManager::onLoadFile() {
@@ -158,56 +703,303 @@ void FrameManager::onLoadFile() {
         nullptr,
         "Open File",
         QDir::homePath(),
-        "Sprite Files (*.sprite)");
+        "Sprite Files (*.sprite *.json)");
 
     if (filePath.isEmpty()) {
         return;
     }
 
     QFile file(filePath);
-    file.open(QIODevice::ReadOnly | QIODevice::Text);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Could not open" << filePath << "for reading";
+        return;
+    }
 
-    QByteArray fileData = file.readAll();
+    bool isLoaded;
+    if (SpriteFile::isBinary(file.peek(SpriteFile::HEADER_SIZE))) {
+        file.close();
+        isLoaded = loadBinary(filePath);
+    } else {
+        QByteArray fileData = file.readAll();
+        file.close();
+        isLoaded = loadJson(fileData);
+    }
 
-    file.close();
+    if (isLoaded) {
+        emit fileLoaded();
+    }
+}
 
-    for (int i = frames.size(); i >= 0; i--) {
-        removeFrame(i);
+bool FrameManager::loadBinary(const QString& filePath) {
+    QFile* file = new QFile(filePath);
+    if (!file->open(QIODevice::ReadOnly)) {
+        delete file;
+        return false;
     }
 
-    QJsonObject jsonObj = QJsonDocument::fromJson(fileData).object();
+    // Map the file so only the frames that get accessed are ever paged in. If the file system does not
+    // support mapping, fall back to reading it all, the frames are still only decoded on access.
+    QByteArray fileData;
+    uchar* mappedData = file->map(0, file->size());
+    if (mappedData != nullptr) {
+        fileData = QByteArray::fromRawData(reinterpret_cast<const char*>(mappedData), file->size());
+    } else {
+        fileData = file->readAll();
+        delete file;
+        file = nullptr;
+    }
+
+    int importedSideLength;
+    std::vector<SpriteFile::FrameEntry> entries;
+    if (!SpriteFile::readIndex(fileData, importedSideLength, entries) || entries.empty()) {
+        qWarning() << "The sprite file is corrupt";
+        delete file;
+        return false;
+    }
+
+    // The view only hears about the new frames once they are all in place
+    beginUpdate();
+    std::vector<Frame*> oldFrames = takeFrames();
 
-    int importedSideLength = jsonObj["sideLength"].toInt();
     if (sideLength != importedSideLength) {
         onSetSideLength(importedSideLength);
     }
 
+    std::vector<SpriteFile::EncodedFrame> encodedFrames;
+    encodedFrames.reserve(entries.size());
+    for (const SpriteFile::FrameEntry& entry : entries) {
+        encodedFrames.push_back(SpriteFile::frameAt(fileData.constData(), entry));
+    }
+    addEncodedFrames(encodedFrames);
+
+    notifyFrameCountChanged();
+    notifyFramesChanged();
+    selectFrame(frames.size() - 1);
+    endUpdate();
+
+    // Only now that the view has moved on to the new frames can the old ones and their file go away
+    deleteFrames(oldFrames);
+    releaseMappedFile();
+    mappedFile = file;
+    mappedFileData = fileData;
+    journal.requestCheckpoint();
+
+    startPrefetch();
+
+    return true;
+}
+
+bool FrameManager::loadJson(const QByteArray& fileData) {
+    QJsonDocument document = QJsonDocument::fromJson(fileData);
+    if (!document.isObject()) {
+        qWarning() << "The sprite file is corrupt";
+        return false;
+    }
+
+    QJsonObject jsonObj = document.object();
+    int importedSideLength = jsonObj["sideLength"].toInt();
+    std::vector<QJsonValue> frameValues;
+    std::vector<int> links;
     for (QJsonValue value : jsonObj["frames"].toArray()) {
-        onFrameAdded();
-        frames.back()->loadFromJson(value);
+        int link = -1;
+        if (value.isObject() && value.toObject().contains("link")) {
+            // A link can only point back to a frame that was already loaded, each entry adds exactly one frame
+            QJsonValue linkValue = value.toObject().value("link");
+            link = linkValue.toInt(-1);
+            if (!linkValue.isDouble() || linkValue.toDouble() != link || link < 0 || link >= int(frameValues.size())) {
+                qWarning() << "The sprite file links a frame to one that does not come before it";
+                return false;
+            }
+        }
+        frameValues.push_back(value);
+        links.push_back(link);
     }
 
-    emit framesChanged(getFrames());
-    emit fileLoaded();
+    // Decode every frame on the thread pool before touching any state, the frames are only swapped in after
+    QFuture<QImage> future = QtConcurrent::mapped(frameValues, [importedSideLength](const QJsonValue& value) {
+        if (value.isObject() && value.toObject().contains("link")) {
+            return QImage();
+        }
+        return Frame::imageFromJson(value, importedSideLength).convertToFormat(Frame::FORMAT);
+    });
+    waitForFuture(future);
+
+    beginUpdate();
+    std::vector<Frame*> oldFrames = takeFrames();
+
+    if (sideLength != importedSideLength) {
+        onSetSideLength(importedSideLength);
+    }
+
+    QList<QImage> images = future.results();
+    for (int i = 0; i < images.size(); i++) {
+        if (links[i] >= 0) {
+            frames.push_back(frames[links[i]]);
+        } else {
+            // A frame that could not be decoded stays transparent
+            Frame* frame = new Frame(sideLength);
+            if (!images[i].isNull()) {
+                frame->loadFromImage(images[i]);
+            }
+            frames.push_back(frame);
+        }
+    }
+
+    if (frames.empty()) {
+        frames.push_back(new Frame(sideLength));
+    }
+
+    notifyFrameCountChanged();
+    notifyFramesChanged();
+    selectFrame(frames.size() - 1);
+    endUpdate();
+
+    deleteFrames(oldFrames);
+    releaseMappedFile();
+    journal.requestCheckpoint();
+
+    return true;
+}
+
+void FrameManager::startPrefetch() {
+    cancelPrefetch();
+
+    std::vector<SpriteFile::EncodedFrame> encodedFrames;
+    QSet<Frame*> queuedFrames;
+    for (Frame* frame : frames) {
+        if (!frame->isDecoded() && !queuedFrames.contains(frame)) {
+            queuedFrames.insert(frame);
+            prefetchFrames.push_back(frame);
+            encodedFrames.push_back(frame->encode());
+        }
+    }
+
+    if (prefetchFrames.empty()) {
+        return;
+    }
+
+    int frameSideLength = sideLength;
+    prefetchWatcher.setFuture(QtConcurrent::mapped(encodedFrames, [frameSideLength](const SpriteFile::EncodedFrame& frame) {
+        // Converting on the worker leaves nothing for loadDecoded to do on the GUI thread
+        return SpriteFile::decodeImage(frame, frameSideLength).convertToFormat(Frame::FORMAT);
+    }));
+}
+
+void FrameManager::cancelPrefetch() {
+    prefetchWatcher.cancel();
+    prefetchWatcher.waitForFinished();
+    prefetchFrames.clear();
+}
+
+void FrameManager::onPrefetchResultReady(int index) {
+    // Frames that were removed while the prefetch was running are nulled out
+    if (prefetchWatcher.isCanceled() || index >= int(prefetchFrames.size()) || prefetchFrames[index] == nullptr) {
+        return;
+    }
+
+    QImage image = prefetchWatcher.resultAt(index);
+    if (!image.isNull()) {
+        prefetchFrames[index]->loadDecoded(image);
+        if (prefetchFrames[index] != getSelectedFrame()) {
+            prefetchFrames[index]->compact();
+        }
+    }
+}
+
+template <typename T>
+void FrameManager::waitForFuture(const QFuture<T>& future) {
+    QFutureWatcher<T> watcher;
+    QEventLoop loop;
+
+    connect(&watcher, &QFutureWatcherBase::progressValueChanged, this, [this, &watcher](int value) {
+        emit fileProgress(value, watcher.progressMaximum());
+    });
+    connect(&watcher, &QFutureWatcherBase::finished, &loop, &QEventLoop::quit);
+    watcher.setFuture(future);
+
+    // Keep repainting (and reporting progress) while the pool works, but keep the user from editing
+    // the frames in the middle of it
+    if (!watcher.isFinished()) {
+        loop.exec(QEventLoop::ExcludeUserInputEvents);
+    }
+
+    emit fileProgress(watcher.progressMaximum(), watcher.progressMaximum());
+}
+
+void FrameManager::addEncodedFrames(const std::vector<SpriteFile::EncodedFrame>& encodedFrames) {
+    for (const SpriteFile::EncodedFrame& encodedFrame : encodedFrames) {
+        int link = SpriteFile::linkedFrame(encodedFrame);
+        if (link >= 0 && link < int(frames.size())) {
+            frames.push_back(frames[link]);
+            continue;
+        }
+
+        // Encoded frames are decoded when first shown, without a transparent buffer allocated in the meantime
+        if (!encodedFrame.blob.isNull() && encodedFrame.encoding != SpriteFile::LINK) {
+            frames.push_back(new Frame(sideLength, encodedFrame));
+        } else {
+            frames.push_back(new Frame(sideLength));
+        }
+    }
+}
+
+void FrameManager::deleteFrames(const std::vector<Frame*>& oldFrames) {
+    // Linked frames appear more than once, but may only be deleted once
+    QSet<Frame*> uniqueFrames(oldFrames.begin(), oldFrames.end());
+    for (Frame* frame : uniqueFrames) {
+        journal.forgetFrame(frame);
+    }
+    qDeleteAll(uniqueFrames);
+}
+
+std::vector<Frame*> FrameManager::takeFrames() {
+    cancelPrefetch();
+
+    std::vector<Frame*> oldFrames;
+    oldFrames.swap(frames);
+    selectedFrameIndex = -1;
+    animFrameIndex = 0;
+
+    // Loaded frames always store colors, the palette does not carry over
+    if (!palette.isEmpty()) {
+        palette.clear();
+        journal.markPaletteChanged(palette);
+        emit paletteChanged(palette);
+    }
+    return oldFrames;
+}
+
+void FrameManager::releaseMappedFile() {
+    // The prefetch reads straight out of the mapping
+    cancelPrefetch();
+
+    // Destroying the QFile also unmaps it
+    if (saveWatcher.isRunning() || journalWatcher.isRunning()) {
+        retiredFiles.push_back(std::make_pair(mappedFile, mappedFileData));
+    } else {
+        delete mappedFile;
+    }
+    mappedFile = nullptr;
+    mappedFileData.clear();
 }
 
 void FrameManager::onRotateCW() {
     getSelectedFrame()->rotate(true);
-    emit selectedFrameChanged(getSelectedFrame());
-    emit framesChanged(getFrames());
+    journal.markFrameChanged(getSelectedFrame());
+    emitSelectedFrameReset();
 }
 void FrameManager::onRotateCCW() {
     getSelectedFrame()->rotate(false);
-    emit selectedFrameChanged(getSelectedFrame());
-    emit framesChanged(getFrames());
+    journal.markFrameChanged(getSelectedFrame());
+    emitSelectedFrameReset();
 }
 void FrameManager::onFlipAlongX() {
     getSelectedFrame()->flip(true);
-    emit selectedFrameChanged(getSelectedFrame());
-    emit framesChanged(getFrames());
+    journal.markFrameChanged(getSelectedFrame());
+    emitSelectedFrameReset();
 }
 void FrameManager::onFlipAlongY() {
     getSelectedFrame()->flip(false);
-    emit selectedFrameChanged(getSelectedFrame());
-    emit framesChanged(getFrames());
+    journal.markFrameChanged(getSelectedFrame());
+    emitSelectedFrameReset();
 }
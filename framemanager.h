@@ -18,12 +18,21 @@
 
 #include <QObject>
 #include <QPoint>
+#include <QRect>
 #include <QColor>
 #include <QTimer>
 #include <QString>
 #include <QJsonDocument>
+#include <QFile>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QPromise>
+#include <QImage>
+#include <QList>
 #include <vector>
+#include <utility>
 #include "frame.h"
+#include "autosavejournal.h"
 
 class FrameManager : public QObject
 {
@@ -35,6 +44,9 @@ public:
     /// \param parent The parent of this QObject, necessary for the QT framework
     explicit FrameManager(int sideLength = 16, int fps = 30, QObject *parent = nullptr);
 
+    /// \brief Destructor for the frame manager, deleting all frames and unmapping the loaded file.
+    ~FrameManager();
+
     /// \brief Select a frame stored in the frame manager. Emits the selectFrameSignal to listeners to reflect the selection.
     /// \param frameIndex The index of the frame to select. Must be a valid index within the the frames vector.
     void selectFrame(int frameIndex);
@@ -55,6 +67,30 @@ public:
     /// \brief Returns a vector of Frame objects stored in the frame manager.
     std::vector<Frame*>& getFrames();
 
+    /// \brief Checks if an autosave journal was left behind by a session that did not exit cleanly. The journal of
+    /// another instance that is still running does not count.
+    bool hasAutosaveJournal() const;
+
+    /// \brief Replaces all frames with the ones recovered from the autosave journal.
+    /// \return True if the journal could be recovered.
+    bool recoverAutosave();
+
+    /// \brief Deletes the autosave journal left behind by a previous session.
+    void discardAutosave();
+
+    /// \brief Starts autosaving into the journal. Must only be called once the user had the chance to recover
+    /// the journal of a previous session, since the first autosave replaces it. Does nothing while another
+    /// instance holds the journal.
+    void startAutosave();
+
+    /// \brief Starts a transaction. Until the matching endUpdate, frameCountChanged, framesChanged, the selection
+    /// and the modified region of the selected frame are only recorded, not emitted. Transactions can be nested.
+    void beginUpdate();
+
+    /// \brief Ends a transaction started by beginUpdate. When the outermost transaction ends, every change
+    /// recorded during it is emitted once.
+    void endUpdate();
+
 signals:
     void selectedFrameChanged(Frame* newSelectedFrame);
     void sideLengthChanged(int newSideLength);
@@ -63,12 +99,24 @@ signals:
     void frameSelected(int frameIndex);
     void animationPreviewUpdated(const Frame& frame);
     void fileLoaded();
+    void fileProgress(int value, int maximum);
+    void fileSaved(const QString& filePath);
+    void fileSaveFailed(const QString& filePath, const QString& error);
+    void paletteChanged(const QList<QRgb>& palette);
+    void selectedFrameRegionChanged(const QRect& region);
+    void frameModified(Frame* frame, const QRect& region);
 
 public slots:
-    /// \brief Slot capturing when a frame is painted and updating the stored pixmap to reflect this change.
-    /// \param pixelPos The position of the pixel that was painted.
-    /// \param color The color of the painted pixel.
-    void onPainted(QPoint pixelPos, QColor color);
+    /// \brief Slot capturing when the selected frame is painted and updating its pixels to reflect this change.
+    /// The whole batch is applied before the change is announced once.
+    /// \param batch The painted spans, in painting order.
+    void onPaintBatch(const PaintBatch& batch);
+
+    /// \brief Slot capturing when pixels are pasted into the selected frame, e.g. when a selection is anchored.
+    /// \param pixels The pasted pixels, in Frame::FORMAT.
+    /// \param mask Where to paste, in Format_Alpha8 with the size of pixels.
+    /// \param position Where the top left corner of pixels goes, in canvas pixels.
+    void onPastePixels(const QImage& pixels, const QImage& mask, QPoint position);
 
     /// \brief Slot capturing when a frame is selected by a user.
     /// \param frameIndex the index of the selected frame.
@@ -80,10 +128,28 @@ public slots:
     /// \brief Slot capturing when a frame is removed by a user.
     void onFrameRemove();
 
+    /// \brief Slot capturing when a user adds a linked frame. The selected frame appears once more right after
+    /// itself, sharing one image, so painting on either shows on both.
+    void onFrameLinked();
+
+    /// \brief Slot capturing when a user unlinks the selected frame, giving it its own copy of the image.
+    void onFrameUnlinked();
+
     /// \brief Slot capturing when a user changes the side length of the canvas.
     /// \param length The new length of frames.
     void onSetSideLength(int length);
 
+    /// \brief Slot capturing when a user switches indexed color mode on or off. Switching it on builds a palette
+    /// of every color in the project, and fails if there are more than MAX_PALETTE_SIZE of them.
+    /// \param enabled Whether the frames should store palette indices instead of colors.
+    void onIndexedModeSet(bool enabled);
+
+    /// \brief Slot capturing when a user swaps a palette color. Every pixel using that entry changes color at
+    /// once, without rewriting any pixels.
+    /// \param index The entry of the palette. Entry 0 is transparent and cannot be changed.
+    /// \param color The new color of the entry.
+    void onPaletteColorSet(int index, QColor color);
+
     /// \brief Slot capturing when a user updates the frames per second of the animation preview.
     /// \param newFps The new frames per second of the animation preview.
     void onFpsUpdated(int newFps);
@@ -93,37 +159,190 @@ public slots:
     void onUpdatePreview();
 
     /// \brief Slot capturing when the user rotates frames clockwise.
-    /// Emits the selectedFrameChanged and the framesChanged signals.
+    /// Emits the selectedFrameRegionChanged and the frameModified signals.
     void onRotateCW();
 
     /// \brief Slot capturing when the user rotates frames counter clockwise.
-    /// Emits the selectedFrameChanged and the framesChanged signals.
+    /// Emits the selectedFrameRegionChanged and the frameModified signals.
     void onRotateCCW();
 
     /// \brief Slot capturing when the user flips frames along the X axis.
-    /// Emits the selectedFrameChanged and the framesChanged signals.
+    /// Emits the selectedFrameRegionChanged and the frameModified signals.
     void onFlipAlongX();
 
     /// \brief Slot capturing when the user flips frames along the Y axis.
-    /// Emits the selectedFrameChanged and the framesChanged signals.
+    /// Emits the selectedFrameRegionChanged and the frameModified signals.
     void onFlipAlongY();
 
     /// \brief Slot capturing when the user saves their project, saving all frames stored in the frame manager to a serializable format.
-    /// Files are saved with the file extension .sprite and can be loaded to continue working on a project starting from where the project
-    /// was saved.
+    /// The frames are snapshotted and written in the background, emitting fileSaved or fileSaveFailed when done, so the user
+    /// can keep editing meanwhile.
+    /// Files are saved in the binary .sprite format (see SpriteFile), or in the row JSON schema when a .json file is picked,
+    /// and can be loaded to continue working on a project starting from where the project was saved.
     void onSaveFile();
 
     /// \brief Slot capturing when the user loads a project.
     /// Users may load files with the format .sprite to initialize the sprite editor with a previously saved project.
+    /// Both the binary format and the JSON formats are accepted, told apart by the binary magic number.
     void onLoadFile();
     
 private:
+    /// \brief Replaces all frames with the ones stored in a binary .sprite file. The file is memory-mapped and
+    /// only its frame table is parsed, each frame is decoded the first time its pixels are accessed.
+    /// Frames are left untouched if the file is corrupt.
+    /// \param filePath The path of the file.
+    /// \return True if the file was loaded.
+    bool loadBinary(const QString& filePath);
+
+    /// \brief Replaces all frames with the ones stored in a JSON file, either in the legacy per-pixel schema or in
+    /// the row schema written by writeSnapshot. Frames are left untouched if the file is corrupt.
+    /// \param fileData The contents of the file.
+    /// \return True if the file was loaded.
+    bool loadJson(const QByteArray& fileData);
+
+    /// \brief Everything a background save needs, so it never touches the live frames.
+    struct SaveSnapshot {
+        QString filePath;
+        bool isJson = false;
+        int sideLength = 0;
+        std::vector<Frame::Snapshot> frames;
+        /// For each frame, the index of the earlier frame it is linked to, or -1. Linked frames have an
+        /// empty snapshot.
+        std::vector<int> links;
+    };
+
+    /// \brief Captures the current frames for a save. Only copies references, no pixels.
+    /// \param filePath The path to save to.
+    /// \param isJson Whether to write the row JSON schema instead of the binary format.
+    /// \return The snapshot.
+    SaveSnapshot takeSnapshot(const QString& filePath, bool isJson);
+
+    /// \brief Starts writing a snapshot on the thread pool. Completion is reported by onSaveFinished.
+    /// \param snapshot The snapshot to write.
+    void startSave(const SaveSnapshot& snapshot);
+
+    /// \brief Serializes a snapshot, encoding the frames in parallel, and atomically replaces the target file
+    /// with the result. Runs on a worker thread.
+    /// The row JSON schema stays reviewable as text: the document is not indented, but every pixel row of every
+    /// frame sits on its own line, so diffs are per row.
+    /// \param promise Receives the progress and, as the result, an error message, empty on success.
+    /// \param snapshot The snapshot to write.
+    static void writeSnapshot(QPromise<QString>& promise, const SaveSnapshot& snapshot);
+
+    /// \brief Slot periodically appending what changed since the last autosave to the journal, or compacting the
+    /// journal into a checkpoint once it has grown too much. Either is encoded and written in the background.
+    void onAutosave();
+
+    /// \brief Deletes the files retired by releaseMappedFile once no save or journal write can read from them.
+    void deleteRetiredFiles();
+
+    /// \brief Deletes frames handed out by takeFrames.
+    /// \param oldFrames The frames to delete.
+    void deleteFrames(const std::vector<Frame*>& oldFrames);
+
+    /// \brief Slot capturing when a background save has finished, reporting how it went and starting the save
+    /// that was requested in the meantime, if any.
+    void onSaveFinished();
+
+    /// \brief Removes every frame without notifying listeners, handing them to the caller. The caller deletes
+    /// them once listeners no longer point at them.
+    /// \return The removed frames.
+    std::vector<Frame*> takeFrames();
+
+    /// \brief Creates the frames of a loaded project from their encoded pixels, leaving them undecoded.
+    /// A link reuses the earlier frame it points to instead of creating a new one.
+    /// \param encodedFrames The encoded frames, in order.
+    void addEncodedFrames(const std::vector<SpriteFile::EncodedFrame>& encodedFrames);
+
+    /// \brief Returns every frame once, even if it is linked into the timeline more than once.
+    std::vector<Frame*> distinctFrames() const;
+
+    /// \brief Adds a color to the palette in indexed mode, unless it is already there or the palette is full,
+    /// in which case painting with it uses the nearest entry.
+    /// \param color The color to add.
+    void addPaletteColor(QColor color);
+
+    /// \brief Makes the selected frame take a new palette right away, since the canvas draws its pixel buffer
+    /// directly. Other frames take it when their pixels are next accessed, see Frame::setColorTable.
+    void refreshSelectedColorTable();
+
+    /// \brief Emits selectedFrameRegionChanged and frameModified with the part of the selected frame that was
+    /// modified since the last time, so the canvas only redraws that part and only its preview is refreshed.
+    void emitSelectedFrameRegion();
+
+    /// \brief Emits selectedFrameChanged for a selected frame whose pixels all moved or changed storage, so the
+    /// canvas redraws it in full and drops the stroke history it kept for the old pixels. Inside a transaction the
+    /// frame is selected again when it ends.
+    void emitSelectedFrameReset();
+
+    /// \brief Emits frameCountChanged, or records it for the end of the running transaction.
+    void notifyFrameCountChanged();
+
+    /// \brief Emits framesChanged, or records it for the end of the running transaction.
+    void notifyFramesChanged();
+
+    /// \brief Compacts every frame except the selected one into tiles, so only the frame being edited keeps
+    /// a full pixel buffer. See Frame::compact.
+    void compactIdleFrames();
+
+    /// \brief Decodes every frame that is still encoded on the thread pool, in the background. Frames accessed
+    /// before their turn are still decoded on the spot.
+    void startPrefetch();
+
+    /// \brief Stops the background decoding started by startPrefetch and waits for the running jobs.
+    void cancelPrefetch();
+
+    /// \brief Slot capturing when the background decoding has finished a frame, handing the pixels to it.
+    /// \param index The index of the frame among the prefetched frames.
+    void onPrefetchResultReady(int index);
+
+    /// \brief Waits for work on the thread pool to finish while reporting its progress with fileProgress.
+    /// Events keep being processed meanwhile, except user input.
+    /// \param future The future of the work.
+    template <typename T>
+    void waitForFuture(const QFuture<T>& future);
+
+    /// \brief Unmaps and closes the file the frames were loaded from, if any. While a save is running the file
+    /// is only retired, since the save's snapshot may still read blobs out of it.
+    /// No frame may still hold a pending blob pointing into it.
+    void releaseMappedFile();
+
     int selectedFrameIndex;
     int sideLength;
+    // How many transactions are open, see beginUpdate, and the notifications they hold back
+    int updateDepth = 0;
+    bool isFrameCountChangePending = false;
+    bool isFramesChangePending = false;
+    bool isSelectionChangePending = false;
     int fps;
     int animFrameIndex = 0;
     std::vector<Frame*> frames;
     QTimer animationTimer;
+    // The file lazily loaded frames point into, kept open while mapped. Null if nothing is mapped.
+    QFile* mappedFile = nullptr;
+    // The bytes of the loaded binary file, either wrapping the mapping or a copy read into memory
+    QByteArray mappedFileData;
+    // Frames being decoded in the background, in the order of prefetchWatcher's results
+    std::vector<Frame*> prefetchFrames;
+    QFutureWatcher<QImage> prefetchWatcher;
+    QFutureWatcher<QString> saveWatcher;
+    // The path the running save writes to
+    QString saveFilePath;
+    // A save requested while another one was running, started once that one finishes
+    SaveSnapshot pendingSave;
+    bool hasPendingSave = false;
+    // Loaded files released while a save was running, with their data, kept alive until no save needs them
+    std::vector<std::pair<QFile*, QByteArray>> retiredFiles;
+    // The palette of indexed color mode as non-premultiplied ARGB, with transparent at index 0. Empty while
+    // the frames store colors.
+    QList<QRgb> palette;
+    const int MAX_PALETTE_SIZE = 256;
+    const int AUTOSAVE_INTERVAL_MS = 5000;
+    AutosaveJournal journal;
+    QTimer autosaveTimer;
+    // Writes either a checkpoint or an append to the journal, never both at once
+    QFutureWatcher<qint64> journalWatcher;
+    bool isWritingCheckpoint = false;
 };
 
 #endif // FRAMEMANAGER_H
@@ -0,0 +1,130 @@
+/*
+    Authors: Zhuyi Bu, Zhenzhi Liu, Justin Melore, Maxwell Rodgers, Duke Nguyen, Minh Khoa Ngo
+    Github usernames: 1144761429, 0doxes0, JustinMelore, maxdotr, duke7012, Mkhoa161
+    Date: November 19th, 2024
+    Class: CS3505, Fall 2024
+    Assignment - A8: Sprite Editor Implementation
+
+    The cpp file for the FramePreviewModel class.
+*/
+
+#include "framepreviewmodel.h"
+#include <QFutureWatcher>
+#include <QSize>
+#include <QtConcurrent>
+
+FramePreviewModel::FramePreviewModel(QObject *parent)
+    : QAbstractListModel(parent) {
+    thumbnails.setMaxCost(MAX_CACHED_THUMBNAILS);
+}
+
+void FramePreviewModel::setFrames(const std::vector<Frame*>& newFrames) {
+    beginResetModel();
+    frames = newFrames;
+    appearances.clear();
+    for (const Frame* frame : frames) {
+        appearances[frame]++;
+    }
+
+    // Resizing or changing the palette also comes through here, so every thumbnail is redrawn. Frames that are
+    // still around keep showing their old one until then, the ones of removed frames are dropped.
+    pendingJobs.clear();
+    staleFrames.clear();
+    for (const Frame* frame : thumbnails.keys()) {
+        if (appearances.contains(frame)) {
+            staleFrames.insert(frame);
+        } else {
+            thumbnails.remove(frame);
+        }
+    }
+    endResetModel();
+}
+
+void FramePreviewModel::invalidateFrame(const Frame* frame) {
+    if (!appearances.contains(frame)) {
+        return;
+    }
+
+    // The old thumbnail keeps showing until the new one is ready, and a job that was already running
+    // started from pixels that are out of date
+    pendingJobs.remove(frame);
+    if (thumbnails.contains(frame)) {
+        staleFrames.insert(frame);
+    }
+    emitFrameRowsChanged(frame);
+}
+
+int FramePreviewModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : int(frames.size());
+}
+
+QVariant FramePreviewModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || index.row() >= int(frames.size())) {
+        return QVariant();
+    }
+
+    Frame* frame = frames[index.row()];
+    switch (role) {
+        case Qt::DecorationRole: {
+            // Only rows the view shows are asked for, so only they get a thumbnail
+            QPixmap* thumbnail = thumbnails.object(frame);
+            if (thumbnail == nullptr || staleFrames.contains(frame)) {
+                requestThumbnail(frame);
+            }
+            return thumbnail != nullptr ? QVariant::fromValue(*thumbnail) : QVariant();
+        }
+        case Qt::ToolTipRole:
+            return appearances.value(frame) > 1 ? QVariant(QString("Linked frame")) : QVariant();
+        case Qt::SizeHintRole:
+            return QSize(ITEM_SIZE, ITEM_SIZE);
+        default:
+            return QVariant();
+    }
+}
+
+void FramePreviewModel::requestThumbnail(Frame* frame) const {
+    if (pendingJobs.contains(frame)) {
+        return;
+    }
+    quint64 jobId = nextJobId++;
+    pendingJobs.insert(frame, jobId);
+
+    // The job only sees the snapshot, so the frame can keep being painted on or even be deleted meanwhile.
+    // The blob of an undecoded frame may point into the loaded file, which can be closed before the job runs.
+    Frame::Snapshot snapshot = frame->snapshot();
+    if (!snapshot.encoded.blob.isNull()) {
+        snapshot.encoded.blob = QByteArray(snapshot.encoded.blob.constData(), snapshot.encoded.blob.size());
+    }
+    int sideLength = frame->getSideLength();
+
+    // data() is const, but starting a job and storing its result is only caching
+    FramePreviewModel* self = const_cast<FramePreviewModel*>(this);
+    QFutureWatcher<QImage>* watcher = new QFutureWatcher<QImage>(self);
+    connect(watcher, &QFutureWatcherBase::finished, self, [self, watcher, frame, jobId]() {
+        self->onThumbnailReady(frame, jobId, watcher->result());
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run([snapshot, sideLength]() {
+        return Frame::decodeSnapshot(snapshot, sideLength).scaled(THUMBNAIL_SIZE, THUMBNAIL_SIZE, Qt::KeepAspectRatio);
+    }));
+}
+
+void FramePreviewModel::onThumbnailReady(const Frame* frame, quint64 jobId, const QImage& thumbnail) {
+    auto pendingJob = pendingJobs.constFind(frame);
+    if (pendingJob == pendingJobs.constEnd() || pendingJob.value() != jobId) {
+        return;
+    }
+    pendingJobs.erase(pendingJob);
+
+    thumbnails.insert(frame, new QPixmap(QPixmap::fromImage(thumbnail)));
+    staleFrames.remove(frame);
+    emitFrameRowsChanged(frame);
+}
+
+void FramePreviewModel::emitFrameRowsChanged(const Frame* frame) {
+    for (int row = 0; row < int(frames.size()); row++) {
+        if (frames[row] == frame) {
+            emit dataChanged(index(row), index(row), {Qt::DecorationRole});
+        }
+    }
+}
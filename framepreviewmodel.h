@@ -0,0 +1,80 @@
+/*
+    Authors: Zhuyi Bu, Zhenzhi Liu, Justin Melore, Maxwell Rodgers, Duke Nguyen, Minh Khoa Ngo
+    Github usernames: 1144761429, 0doxes0, JustinMelore, maxdotr, duke7012, Mkhoa161
+    Date: November 19th, 2024
+    Class: CS3505, Fall 2024
+    Assignment - A8: Sprite Editor Implementation
+
+    The FramePreviewModel class presents the frames of the sprite to the frame strip, one row per frame. The view
+    only asks for the rows it shows, so thumbnails are made lazily: the first time a row is shown, its frame is
+    captured as a Frame::Snapshot and scaled down on the thread pool, and the row shows the thumbnail once it is
+    ready. Thumbnails are kept in a bounded cache that drops the least recently shown ones, so memory follows what
+    is on screen rather than the length of the sprite. Linked frames share one thumbnail.
+*/
+
+#ifndef FRAMEPREVIEWMODEL_H
+#define FRAMEPREVIEWMODEL_H
+
+#include <QAbstractListModel>
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QPixmap>
+#include <QSet>
+#include <vector>
+#include "frame.h"
+
+class FramePreviewModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    static const int THUMBNAIL_SIZE = 80;
+    static const int ITEM_SIZE = 82;
+    static const int MAX_CACHED_THUMBNAILS = 256;
+
+    /// \brief Constructor for the model, starting out without frames.
+    /// \param parent The parent of this QObject, necessary for the QT framework
+    explicit FramePreviewModel(QObject *parent = nullptr);
+
+    /// \brief setFrames Replace the frames shown in the strip. Every thumbnail is redrawn, since the pixels of the
+    /// frames may have changed along with them.
+    /// \param newFrames The frames of the sprite, in order.
+    void setFrames(const std::vector<Frame*>& newFrames);
+
+    /// \brief invalidateFrame Drop the thumbnail of a frame whose pixels changed, so every row showing it is
+    /// redrawn with a fresh one.
+    /// \param frame The modified frame.
+    void invalidateFrame(const Frame* frame);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+private:
+    std::vector<Frame*> frames;
+    // How often each frame appears, more than once for linked frames
+    QHash<const Frame*, int> appearances;
+    // Least recently used thumbnails are dropped first once the cache is full
+    mutable QCache<const Frame*, QPixmap> thumbnails;
+    // Frames whose cached thumbnail is out of date, still shown until the fresh one is ready
+    QSet<const Frame*> staleFrames;
+    // The id of the thumbnail job running for a frame. A result whose id no longer matches is stale.
+    mutable QHash<const Frame*, quint64> pendingJobs;
+    mutable quint64 nextJobId = 0;
+
+    /// \brief requestThumbnail Start scaling down a frame on the thread pool, unless that is already running.
+    /// \param frame The frame.
+    void requestThumbnail(Frame* frame) const;
+
+    /// \brief onThumbnailReady Store a finished thumbnail and redraw the rows of its frame.
+    /// \param frame The frame.
+    /// \param jobId The id the job was started with.
+    /// \param thumbnail The scaled down frame.
+    void onThumbnailReady(const Frame* frame, quint64 jobId, const QImage& thumbnail);
+
+    /// \brief emitFrameRowsChanged Tell the view that the thumbnail of every row showing a frame changed.
+    /// \param frame The frame.
+    void emitFrameRowsChanged(const Frame* frame);
+};
+
+#endif // FRAMEPREVIEWMODEL_H
@@ -18,6 +18,13 @@
 #include "framemanager.h"
 #include "canvassizing.h"
 #include <QTimer>
+#include <QInputDialog>
+#include <QColorDialog>
+#include <QSignalBlocker>
+#include <QProgressBar>
+#include <QMessageBox>
+#include <QActionGroup>
+#include <QFileDialog>
 
 MainWindow::MainWindow(FrameManager& frameManager, QWidget *parent)
     : QMainWindow(parent)
@@ -25,8 +32,9 @@ MainWindow::MainWindow(FrameManager& frameManager, QWidget *parent)
     ui->setupUi(this);
     canvasSizing = new CanvasSizing();
     
-    frameLabels = ui->scrollAreaWidgetContents->findChildren<QLabel*>();
-    frameLabels[0]->installEventFilter(this);
+    // The strip only creates what is scrolled into view, thumbnails are made on demand by the model
+    framePreviewModel = new FramePreviewModel(this);
+    ui->framePreviewList->setModel(framePreviewModel);
 
     // Add actions to a group so that they're exclusive
     toolButtonGroup = new QButtonGroup(this);
@@ -38,6 +46,9 @@ MainWindow::MainWindow(FrameManager& frameManager, QWidget *parent)
     toolButtonGroup->addButton(ui->filledBoxShapeButton, 5);
     toolButtonGroup->addButton(ui->triangleShapeButton, 6);
     toolButtonGroup->addButton(ui->filledTriangleShapeButton, 7);
+    toolButtonGroup->addButton(ui->bucketButton, 8);
+    toolButtonGroup->addButton(ui->selectButton, 9);
+    toolButtonGroup->addButton(ui->lassoButton, 10);
 
     // Pen and eraser in the toolbar(not checkable)
     connect(ui->actionPen,
@@ -60,6 +71,37 @@ MainWindow::MainWindow(FrameManager& frameManager, QWidget *parent)
             ui->canvas,
             &Canvas::onMirrorModeSet);
 
+    // Brush and eraser tip
+    ui->brushSizeSpinBox->setMaximum(Brush::MAX_SIZE);
+    connect(ui->brushSizeSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), ui->canvas, &Canvas::onBrushSizeSet);
+    connect(ui->brushShapeComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &MainWindow::onBrushShapeSelected);
+
+    // Bucket fill options
+    ui->fillToleranceSpinBox->setMaximum(FloodFill::MAX_TOLERANCE);
+    connect(ui->fillToleranceSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), ui->canvas, &Canvas::onFillToleranceSet);
+    connect(ui->fillDiagonalCheckBox, &QCheckBox::toggled, ui->canvas, &Canvas::onFillDiagonalSet);
+    connect(ui->fillAllMatchingCheckBox, &QCheckBox::toggled, ui->canvas, &Canvas::onFillAllMatchingSet);
+
+    // Symmetry beyond mirroring left to right, the rotations being exclusive
+    connect(ui->actionMirrorTopBottom, &QAction::toggled, ui->canvas, &Canvas::onMirrorTopBottomSet);
+    connect(ui->actionResetSymmetryCenter, &QAction::triggered, ui->canvas, &Canvas::onSymmetryCenterReset);
+    QActionGroup* rotationGroup = new QActionGroup(this);
+    const std::pair<QAction*, int> rotationActions[] = {
+        {ui->actionRotationalSymmetryOff, 1},
+        {ui->actionRotationalSymmetry2, 2},
+        {ui->actionRotationalSymmetry3, 3},
+        {ui->actionRotationalSymmetry4, 4},
+        {ui->actionRotationalSymmetry6, 6},
+        {ui->actionRotationalSymmetry8, 8}
+    };
+    for (const std::pair<QAction*, int>& rotationAction : rotationActions) {
+        int count = rotationAction.second;
+        rotationGroup->addAction(rotationAction.first);
+        connect(rotationAction.first, &QAction::triggered, ui->canvas, [this, count]() {
+            ui->canvas->onRotationalSymmetrySet(count);
+        });
+    }
+
     // Transformations
     connect(ui->actionCwRotate,
             &QAction::triggered,
@@ -148,6 +190,19 @@ MainWindow::MainWindow(FrameManager& frameManager, QWidget *parent)
     // Load
     connect(ui->actionLoad, &QAction::triggered, &frameManager, &FrameManager::onLoadFile);
     connect(&frameManager, &FrameManager::fileLoaded, this, &MainWindow::onFileLoaded);
+
+    // Save/load progress
+    fileProgressBar = new QProgressBar(this);
+    fileProgressBar->setMaximumWidth(200);
+    fileProgressBar->hide();
+    ui->statusbar->addPermanentWidget(fileProgressBar);
+    connect(&frameManager, &FrameManager::fileProgress, this, &MainWindow::onFileProgress);
+    connect(&frameManager, &FrameManager::fileSaved, this, [this](const QString& filePath) {
+        ui->statusbar->showMessage("Saved " + filePath, 3000);
+    });
+    connect(&frameManager, &FrameManager::fileSaveFailed, this, [this](const QString& filePath, const QString& error) {
+        QMessageBox::warning(this, "Save Failed", "Could not save " + filePath + ":\n" + error);
+    });
     
     // Canvas Sizing
     connect(ui->actionChange_Dimensions, &QAction::triggered, this, &MainWindow::onChangeDimensionClicked);
@@ -157,18 +212,57 @@ MainWindow::MainWindow(FrameManager& frameManager, QWidget *parent)
     // Frame remove
     connect(ui->actionDeleteSelectedFrame, &QAction::triggered, &frameManager, &FrameManager::onFrameRemove);
 
+    // Linked frames
+    connect(ui->actionLinkFrame, &QAction::triggered, &frameManager, &FrameManager::onFrameLinked);
+    connect(ui->actionUnlinkFrame, &QAction::triggered, &frameManager, &FrameManager::onFrameUnlinked);
+
+    // Indexed color mode
+    connect(ui->actionIndexedMode, &QAction::toggled, &frameManager, &FrameManager::onIndexedModeSet);
+    connect(ui->actionSwapPaletteColor, &QAction::triggered, this, &MainWindow::onSwapPaletteColorClicked);
+    connect(this, &MainWindow::paletteColorSet, &frameManager, &FrameManager::onPaletteColorSet);
+    connect(&frameManager, &FrameManager::paletteChanged, this, &MainWindow::onPaletteChanged);
+
+    // Zoom
+    connect(ui->actionZoomIn, &QAction::triggered, ui->canvas, &Canvas::onZoomIn);
+    connect(ui->actionZoomOut, &QAction::triggered, ui->canvas, &Canvas::onZoomOut);
+    connect(ui->actionZoomToFit, &QAction::triggered, ui->canvas, &Canvas::onZoomToFit);
+
+    // Selection. Selecting everything or pasting picks the selection tool, the selection only lives while it is
+    // picked.
+    connect(ui->actionSelectAll, &QAction::triggered, this, [this]() {
+        showSelectionTool();
+        ui->canvas->onSelectAll();
+    });
+    connect(ui->actionPaste, &QAction::triggered, this, [this]() {
+        showSelectionTool();
+        ui->canvas->onPaste();
+    });
+    connect(ui->actionDeselect, &QAction::triggered, ui->canvas, &Canvas::onDeselect);
+    connect(ui->actionCut, &QAction::triggered, ui->canvas, &Canvas::onCut);
+    connect(ui->actionCopy, &QAction::triggered, ui->canvas, &Canvas::onCopy);
+    connect(ui->actionDeleteSelection, &QAction::triggered, ui->canvas, &Canvas::onDeleteSelection);
+
     // Pixel drawing
-    connect(ui->canvas, &Canvas::painted, &frameManager, &FrameManager::onPainted);
+    connect(ui->canvas, &Canvas::paintedBatch, &frameManager, &FrameManager::onPaintBatch);
+    connect(ui->canvas, &Canvas::pastedPixels, &frameManager, &FrameManager::onPastePixels);
     connect(&frameManager, &FrameManager::selectedFrameChanged, ui->canvas, &Canvas::onSelectedFrameChanged);
+    connect(&frameManager, &FrameManager::selectedFrameRegionChanged, ui->canvas, &Canvas::onFrameRegionChanged);
     connect(this, &MainWindow::frameAdded, &frameManager, &FrameManager::onFrameAdded);
     connect(&frameManager, &FrameManager::sideLengthChanged, ui->canvas, &Canvas::onSideLengthChanged);
 
     // Frame previews
     connect(&frameManager, &FrameManager::framesChanged, this, &MainWindow::updateFramePreviews);
+    connect(&frameManager, &FrameManager::frameModified, this, &MainWindow::onFrameModified);
+    previewRefreshTimer.setSingleShot(true);
+    previewRefreshTimer.setInterval(PREVIEW_REFRESH_INTERVAL);
+    connect(&previewRefreshTimer, &QTimer::timeout, this, &MainWindow::refreshModifiedPreviews);
     connect(&frameManager, &FrameManager::frameCountChanged, this, &MainWindow::frameCountChanged);
     connect(ui->frameSpinBox, &QSpinBox::valueChanged, &frameManager, &FrameManager::onFrameSelect);
     connect(this, &MainWindow::frameSelect, &frameManager, &FrameManager::onFrameSelect);
     connect(&frameManager, &FrameManager::frameSelected, this, &MainWindow::onSelectFrame);
+    connect(ui->framePreviewList, &QListView::clicked, this, [this](const QModelIndex& index) {
+        emit frameSelect(index.row());
+    });
 
     // Animation preview
     connect(this, &MainWindow::fpsUpdated, &frameManager, &FrameManager::onFpsUpdated);
@@ -177,6 +271,21 @@ MainWindow::MainWindow(FrameManager& frameManager, QWidget *parent)
     frameManager.onSetSideLength(16);
     frameManager.onFrameAdded();
 
+    // Offer to recover the work of a session that did not exit cleanly, then start autosaving over it
+    QTimer::singleShot(0, this, [&frameManager, this]() {
+        if (frameManager.hasAutosaveJournal()) {
+            QMessageBox::StandardButton answer = QMessageBox::question(
+                this,
+                "Recover Unsaved Work",
+                "The Sprite Editor did not exit cleanly last time. Do you want to recover the unsaved work?");
+
+            if (answer != QMessageBox::Yes || !frameManager.recoverAutosave()) {
+                frameManager.discardAutosave();
+            }
+        }
+        frameManager.startAutosave();
+    });
+
     // Update the frame preview when canvas size changes.
     connect(&frameManager, &FrameManager::sideLengthChanged, this, [&frameManager, this](int _) {this->updateFramePreviews(frameManager.getFrames());});
 }
@@ -245,60 +354,43 @@ void MainWindow::frameCountChanged(int newFrameCount) {
 }
 
 void MainWindow::onSelectFrame(int index) {
-    frameLabels[index]->setStyleSheet("QLabel { border: 1px solid #2196F3; }");
-    if (selectedFrameIndex >= 0 && selectedFrameIndex <= frameLabels.size() - 1 && selectedFrameIndex != index) {
-        frameLabels[selectedFrameIndex]->setStyleSheet("QLabel { border: 1px solid #DEDEDE; }");
-    }
     selectedFrameIndex = index;
+    if (index >= 0 && index < framePreviewModel->rowCount()) {
+        QModelIndex modelIndex = framePreviewModel->index(index);
+        ui->framePreviewList->setCurrentIndex(modelIndex);
+        ui->framePreviewList->scrollTo(modelIndex);
+    }
 }
 
 void MainWindow::updateFramePreviews(const std::vector<Frame*>& frames) {
+    // Every thumbnail is redrawn anyway, so nothing is left for the pending refresh
+    modifiedFrames.clear();
+    previewRefreshTimer.stop();
 
-    QWidget* scrollContent = ui->scrollAreaWidgetContents;
-    QHBoxLayout* layout = qobject_cast<QHBoxLayout*>(scrollContent->layout());
-
-    for (size_t i = 0; i < frames.size(); ++i) {
-        QLabel* label;
-        if (i < frameLabels.size()) { // check & replace existing lables
-            label = frameLabels[i];
-        } else { // no exsiting lables, create new ones
-            label = new QLabel(scrollContent);
-            label->setFixedSize(82, 82);
-            label->installEventFilter(this);  // install click selector
-            layout->insertWidget(layout->count() - 1, label);
-        }
-        QPixmap scaledPixmap = frames[i]->pixmap.scaled(80, 80, Qt::KeepAspectRatio);
-        label->setPixmap(scaledPixmap);
-    }
+    // Resetting the model drops the current row, so the selection is put back
+    framePreviewModel->setFrames(frames);
+    onSelectFrame(selectedFrameIndex);
+}
 
-    // delete excessive frames
-    while (frameLabels.size() > frames.size()) {
-        QLabel* label = frameLabels.takeLast();
-        layout->removeWidget(label);
-        delete label;
+void MainWindow::onFrameModified(Frame* frame, const QRect&) {
+    modifiedFrames.insert(frame);
+    if (!previewRefreshTimer.isActive()) {
+        previewRefreshTimer.start();
     }
+}
 
-    //renew frameLabels for indexing
-    frameLabels = scrollContent->findChildren<QLabel*>();
+void MainWindow::refreshModifiedPreviews() {
+    for (const Frame* frame : modifiedFrames) {
+        framePreviewModel->invalidateFrame(frame);
+    }
+    modifiedFrames.clear();
 }
 
 void MainWindow::updateAnimationPreview(const Frame& frame) {
-    QPixmap scaledPixmap = frame.pixmap.scaled(80,80);
+    QPixmap scaledPixmap = QPixmap::fromImage(frame.thumbnail(80));
     ui->AnimationPreview->setPixmap(scaledPixmap);
 }
 
-bool MainWindow::eventFilter(QObject *obj, QEvent *event) {
-    if (event->type() == QEvent::MouseButtonPress) {
-        QLabel* label = qobject_cast<QLabel*>(obj);
-        if (label && frameLabels.contains(label)) {
-            int clickedIndex = frameLabels.indexOf(label);
-            emit frameSelect(clickedIndex);
-            return true;
-        }
-    }
-    return QMainWindow::eventFilter(obj, event);
-}
-
 void MainWindow::onFpsChanged(int fps) {
     emit fpsUpdated(fps);
 }
@@ -307,6 +399,83 @@ void MainWindow::onChangeDimensionClicked() {
     canvasSizing->exec();
 }
 
+void MainWindow::onFileProgress(int value, int maximum) {
+    if (value >= maximum) {
+        fileProgressBar->hide();
+        return;
+    }
+
+    fileProgressBar->setRange(0, maximum);
+    fileProgressBar->setValue(value);
+    fileProgressBar->show();
+}
+
+void MainWindow::onPaletteChanged(const QList<QRgb>& newPalette) {
+    palette = newPalette;
+
+    // Switching indexed mode on can fail, so the check mark follows the palette rather than the click
+    QSignalBlocker blocker(ui->actionIndexedMode);
+    ui->actionIndexedMode->setChecked(!palette.isEmpty());
+    ui->actionSwapPaletteColor->setEnabled(!palette.isEmpty());
+}
+
+void MainWindow::onSwapPaletteColorClicked() {
+    // Entry 0 is the transparent color, which always stays transparent
+    QStringList entries;
+    for (int i = 1; i < palette.size(); i++) {
+        entries.append(QString("%1: %2").arg(i).arg(QColor::fromRgba(palette[i]).name(QColor::HexArgb)));
+    }
+    if (entries.isEmpty()) {
+        return;
+    }
+
+    bool isAccepted;
+    QString entry = QInputDialog::getItem(this, "Swap Palette Color", "Palette color:", entries, 0, false, &isAccepted);
+    if (!isAccepted) {
+        return;
+    }
+
+    int index = entries.indexOf(entry) + 1;
+    QColor color = QColorDialog::getColor(QColor::fromRgba(palette[index]), this, "New Color",
+                                          QColorDialog::ShowAlphaChannel);
+    if (color.isValid()) {
+        emit paletteColorSet(index, color);
+    }
+}
+
+void MainWindow::onBrushShapeSelected(int shape) {
+    if (shape != Brush::CUSTOM) {
+        brushShape = shape;
+        ui->canvas->onBrushShapeSet(shape);
+        return;
+    }
+
+    QString filePath = QFileDialog::getOpenFileName(this, "Load Brush Tip", QDir::homePath(),
+                                                    "Images (*.png *.bmp *.gif)");
+    if (!filePath.isEmpty()) {
+        QImage mask;
+        if (!mask.load(filePath)) {
+            QMessageBox::warning(this, "Load Failed", "Could not read " + filePath);
+        } else if (!ui->canvas->onCustomBrushSet(mask)) {
+            QMessageBox::warning(this, "Load Failed", QString("A brush tip has to be at most %1 pixels wide and "
+                                                              "high, with at least one opaque pixel.").arg(Brush::MAX_SIZE));
+        } else {
+            brushShape = shape;
+            return;
+        }
+    }
+
+    // Keep the tip that was in use
+    QSignalBlocker blocker(ui->brushShapeComboBox);
+    ui->brushShapeComboBox->setCurrentIndex(brushShape);
+}
+
+void MainWindow::showSelectionTool() {
+    if (!ui->selectButton->isChecked() && !ui->lassoButton->isChecked()) {
+        ui->selectButton->setChecked(true);
+    }
+}
+
 void MainWindow::onFileLoaded() {
     ui->canvas->repaint();
 }
@@ -19,8 +19,12 @@
 #include <QMainWindow>
 #include <QButtonGroup>
 #include <QLabel>
+#include <QProgressBar>
+#include <QSet>
+#include <QTimer>
 #include "canvas.h"
 #include "framemanager.h"
+#include "framepreviewmodel.h"
 #include "canvassizing.h"
 
 QT_BEGIN_NAMESPACE
@@ -47,6 +51,7 @@ signals:
     void frameAdded();
     void frameSelect(int frameIndex);
     void fpsUpdated(int fps);
+    void paletteColorSet(int index, QColor color);
 
 private slots:
     /// \brief Slot to capture when a user changes the dimensions of the canvas.
@@ -69,6 +74,12 @@ private slots:
     /// \param frames Vector of frames holding frame data to update previews with
     void updateFramePreviews(const std::vector<Frame*>& frames);
 
+    /// \brief Slot to capture when the pixels of one frame change. Its preview is refreshed with the next batch
+    /// of modified previews, so a stroke costs at most one thumbnail per frame per display refresh.
+    /// \param frame The modified frame.
+    /// \param region The modified part of the frame, in canvas pixels.
+    void onFrameModified(Frame* frame, const QRect& region);
+
     /// \brief Slot to update the animation preview.
     /// \param frame The frame data to update the preview window with
     void updateAnimationPreview(const Frame& frame);
@@ -85,17 +96,50 @@ private slots:
     /// \brief Slot to capture when a user loads a .sprite project file, updating display with project information.
     void onFileLoaded();
 
+    /// \brief Slot to capture progress of saving or loading a project, showing it in the status bar.
+    /// \param value The amount of frames processed so far.
+    /// \param maximum The amount of frames to process.
+    void onFileProgress(int value, int maximum);
+
+    /// \brief Slot to capture when the palette of indexed color mode changes, keeping the menu in sync.
+    /// \param newPalette The palette, empty when indexed color mode is off.
+    void onPaletteChanged(const QList<QRgb>& newPalette);
+
+    /// \brief Slot to capture when a user wants to swap a palette color. Asks for the entry and its new color,
+    /// emitting the paletteColorSet signal.
+    void onSwapPaletteColorClicked();
+
+    /// \brief Slot to capture when the user picks a brush shape. Picking the custom shape asks for an image to
+    /// use as the tip.
+    /// \param shape The Brush::Shape.
+    void onBrushShapeSelected(int shape);
+
 private:
     Ui::MainWindow *ui;
     // set to allow exclusive selection between those tools
     QButtonGroup* toolButtonGroup;
     CanvasSizing* canvasSizing;
-    // used to keep track of which frame is selected and has a "frame" that we should make invisible later
+    // Shows the progress of saving and loading in the status bar
+    QProgressBar* fileProgressBar;
+    // The palette of indexed color mode, empty when it is off
+    QList<QRgb> palette;
+    // The selected frame, kept so the strip can select it again after its model was reset
     int selectedFrameIndex = -1;
-    // Lables that are inside frame previews
-    QList<QLabel*> frameLabels;
-    // A click selector that adds to frames
-    bool eventFilter(QObject *obj, QEvent *event) override;
+    // The rows of the frame strip
+    FramePreviewModel* framePreviewModel;
+    // Roughly one display refresh, the most often modified previews are redrawn
+    const int PREVIEW_REFRESH_INTERVAL = 16;
+    // Frames whose previews are stale, redrawn when previewRefreshTimer fires
+    QSet<const Frame*> modifiedFrames;
+    QTimer previewRefreshTimer;
+    // The brush shape in use, picked again when loading a custom tip is cancelled
+    int brushShape = Brush::SQUARE;
     void updateColorPreview(QColor color);
+
+    /// \brief Has the frame strip redraw the previews of the frames modified since the last refresh.
+    void refreshModifiedPreviews();
+
+    /// \brief Picks the rectangle selection tool, unless a selection tool is already picked.
+    void showSelectionTool();
 };
 #endif // MAINWINDOW_H
@@ -0,0 +1,39 @@
+/*
+    Authors: Zhuyi Bu, Zhenzhi Liu, Justin Melore, Maxwell Rodgers, Duke Nguyen, Minh Khoa Ngo
+    Github usernames: 1144761429, 0doxes0, JustinMelore, maxdotr, duke7012, Mkhoa161
+    Date: November 18th, 2024
+    Class: CS3505, Fall 2024
+    Assignment - A8: Sprite Editor Implementation
+
+    The cpp file for the PaintBatch class.
+*/
+
+#include "paintbatch.h"
+
+void PaintBatch::addSpan(int y, int x, int length, QColor color, bool isBlended) {
+    if (length <= 0) {
+        return;
+    }
+
+    // Only the last span is extended, merging with an earlier one would reorder what paints over what
+    if (!spans.empty()) {
+        Span& last = spans.back();
+        if (last.y == y && last.x + last.length == x && last.color == color && last.isBlended == isBlended) {
+            last.length += length;
+            return;
+        }
+    }
+    spans.push_back(Span{y, x, length, color, isBlended});
+}
+
+bool PaintBatch::isEmpty() const {
+    return spans.empty();
+}
+
+const std::vector<PaintBatch::Span>& PaintBatch::getSpans() const {
+    return spans;
+}
+
+void PaintBatch::clear() {
+    spans.clear();
+}
@@ -0,0 +1,53 @@
+/*
+    Authors: Zhuyi Bu, Zhenzhi Liu, Justin Melore, Maxwell Rodgers, Duke Nguyen, Minh Khoa Ngo
+    Github usernames: 1144761429, 0doxes0, JustinMelore, maxdotr, duke7012, Mkhoa161
+    Date: November 18th, 2024
+    Class: CS3505, Fall 2024
+    Assignment - A8: Sprite Editor Implementation
+
+    The PaintBatch class collects everything one input event paints as horizontal spans of a single color, so the
+    canvas hands it to the model in one go instead of one signal per pixel. Spans are applied in the order they
+    were added, so later spans paint over earlier ones.
+*/
+
+#ifndef PAINTBATCH_H
+#define PAINTBATCH_H
+
+#include <QColor>
+#include <vector>
+
+class PaintBatch
+{
+public:
+    /// \brief A horizontal run of pixels painted with one color.
+    struct Span {
+        int y;
+        int x;
+        int length;
+        QColor color;
+        /// Whether the color is blended over the pixels (source-over) instead of replacing them.
+        bool isBlended;
+    };
+
+    /// \brief addSpan Paint a horizontal run of pixels.
+    /// \param y The row of the run.
+    /// \param x The first column of the run.
+    /// \param length The amount of pixels in the run.
+    /// \param color The color of the run.
+    /// \param isBlended Whether to blend the color over the pixels instead of replacing them.
+    void addSpan(int y, int x, int length, QColor color, bool isBlended = false);
+
+    /// \brief isEmpty Check if nothing was painted.
+    bool isEmpty() const;
+
+    /// \brief getSpans Returns the spans in the order they were added.
+    const std::vector<Span>& getSpans() const;
+
+    /// \brief clear Forget every span.
+    void clear();
+
+private:
+    std::vector<Span> spans;
+};
+
+#endif // PAINTBATCH_H
@@ -0,0 +1,240 @@
+/*
+    Authors: Zhuyi Bu, Zhenzhi Liu, Justin Melore, Maxwell Rodgers, Duke Nguyen, Minh Khoa Ngo
+    Github usernames: 1144761429, 0doxes0, JustinMelore, maxdotr, duke7012, Mkhoa161
+    Date: November 21st, 2024
+    Class: CS3505, Fall 2024
+    Assignment - A8: Sprite Editor Implementation
+
+    The cpp file for the Rasterizer class.
+*/
+
+#include "rasterizer.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+
+Rasterizer::Rasterizer(const QRect& clipRect)
+    : clipRect(clipRect) {
+}
+
+void Rasterizer::setClipRect(const QRect& newClipRect) {
+    clipRect = newClipRect;
+}
+
+QRect Rasterizer::getClipRect() const {
+    return clipRect;
+}
+
+void Rasterizer::line(QPoint from, QPoint to) {
+    std::vector<QPoint> pixels;
+    pixels.push_back(from);
+    appendLine(from, to, pixels);
+    for (QPoint pixel : pixels) {
+        addPixel(pixel);
+    }
+}
+
+void Rasterizer::rect(const QRect& rect, bool isFilled) {
+    QRect shape = rect.normalized();
+    if (isFilled) {
+        for (int y = shape.top(); y <= shape.bottom(); y++) {
+            addSpan(y, shape.left(), shape.right());
+        }
+        return;
+    }
+
+    // Top and bottom edges as whole spans, the sides as one pixel per row
+    addSpan(shape.top(), shape.left(), shape.right());
+    addSpan(shape.bottom(), shape.left(), shape.right());
+    for (int y = shape.top() + 1; y < shape.bottom(); y++) {
+        addSpan(y, shape.left(), shape.left());
+        addSpan(y, shape.right(), shape.right());
+    }
+}
+
+void Rasterizer::ellipse(QPoint center, int radiusX, int radiusY, bool isFilled) {
+    std::vector<int> halfWidths = ellipseHalfWidths(std::abs(radiusX), std::abs(radiusY));
+    int top = center.y() - std::abs(radiusY);
+    int rows = int(halfWidths.size());
+
+    for (int row = 0; row < rows; row++) {
+        int y = top + row;
+        int halfWidth = halfWidths[row];
+        if (isFilled) {
+            addSpan(y, center.x() - halfWidth, center.x() + halfWidth);
+            continue;
+        }
+
+        // The outline of a row reaches inwards as far as the narrower neighbouring row ends, so the pixels of
+        // neighbouring rows always touch. The top and bottom rows have no neighbour outside and are drawn whole.
+        int above = row > 0 ? halfWidths[row - 1] : -1;
+        int below = row < rows - 1 ? halfWidths[row + 1] : -1;
+        int inner = std::min(std::min(above, below) + 1, halfWidth);
+        if (inner <= 0) {
+            addSpan(y, center.x() - halfWidth, center.x() + halfWidth);
+        } else {
+            addSpan(y, center.x() - halfWidth, center.x() - inner);
+            addSpan(y, center.x() + inner, center.x() + halfWidth);
+        }
+    }
+}
+
+void Rasterizer::triangle(QPoint a, QPoint b, QPoint c, bool isFilled) {
+    polygon({a, b, c}, isFilled);
+}
+
+void Rasterizer::polygon(const std::vector<QPoint>& vertices, bool isFilled) {
+    if (vertices.empty()) {
+        return;
+    }
+
+    for (size_t i = 0; i < vertices.size(); i++) {
+        line(vertices[i], vertices[(i + 1) % vertices.size()]);
+    }
+    if (!isFilled || vertices.size() < 3) {
+        return;
+    }
+
+    int top = INT_MAX, bottom = INT_MIN;
+    for (QPoint vertex : vertices) {
+        top = std::min(top, vertex.y());
+        bottom = std::max(bottom, vertex.y());
+    }
+    if (!clipRect.isNull()) {
+        top = std::max(top, clipRect.top());
+        bottom = std::min(bottom, clipRect.bottom());
+    }
+
+    // Each row crosses the edges that start at or above it and end below it, so a vertex shared by two edges
+    // is only counted once
+    std::vector<double> crossings;
+    for (int y = top; y <= bottom; y++) {
+        crossings.clear();
+        for (size_t i = 0; i < vertices.size(); i++) {
+            QPoint p1 = vertices[i];
+            QPoint p2 = vertices[(i + 1) % vertices.size()];
+            if ((p1.y() <= y && y < p2.y()) || (p2.y() <= y && y < p1.y())) {
+                crossings.push_back(p1.x() + double(y - p1.y()) * (p2.x() - p1.x()) / (p2.y() - p1.y()));
+            }
+        }
+        std::sort(crossings.begin(), crossings.end());
+        for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+            addSpan(y, int(std::ceil(crossings[i])), int(std::floor(crossings[i + 1])));
+        }
+    }
+}
+
+const std::vector<Rasterizer::Span>& Rasterizer::getSpans() {
+    normalize();
+    return spans;
+}
+
+QRect Rasterizer::boundingRect() {
+    normalize();
+    if (spans.empty()) {
+        return QRect();
+    }
+
+    // Sorted by row, so only the columns need a search
+    int left = INT_MAX, right = INT_MIN;
+    for (const Span& span : spans) {
+        left = std::min(left, span.x);
+        right = std::max(right, span.x + span.length - 1);
+    }
+    return QRect(QPoint(left, spans.front().y), QPoint(right, spans.back().y));
+}
+
+bool Rasterizer::isEmpty() const {
+    return spans.empty();
+}
+
+void Rasterizer::clear() {
+    spans.clear();
+    isNormalized = true;
+}
+
+void Rasterizer::appendLine(QPoint from, QPoint to, std::vector<QPoint>& pixels) {
+    // Bresenham, leaving out the first pixel
+    int dx = std::abs(to.x() - from.x()), dy = std::abs(to.y() - from.y());
+    int sx = from.x() < to.x() ? 1 : -1;
+    int sy = from.y() < to.y() ? 1 : -1;
+    int err = dx - dy;
+    QPoint pixel = from;
+
+    while (pixel != to) {
+        int e2 = 2 * err;
+        if (e2 > -dy) { err -= dy; pixel.rx() += sx; }
+        if (e2 < dx) { err += dx; pixel.ry() += sy; }
+        pixels.push_back(pixel);
+    }
+}
+
+void Rasterizer::addSpan(int y, int left, int right) {
+    if (!clipRect.isNull()) {
+        if (y < clipRect.top() || y > clipRect.bottom()) {
+            return;
+        }
+        left = std::max(left, clipRect.left());
+        right = std::min(right, clipRect.right());
+    }
+    if (left > right) {
+        return;
+    }
+
+    // Consecutive pixels of a line on the same row join the span before them right away
+    if (!spans.empty()) {
+        Span& last = spans.back();
+        if (last.y == y && last.x + last.length == left) {
+            last.length += right - left + 1;
+            return;
+        }
+        if (last.y > y || (last.y == y && last.x > left)) {
+            isNormalized = false;
+        } else if (last.y == y && last.x + last.length > left) {
+            isNormalized = false;
+        }
+    }
+    spans.push_back(Span{y, left, right - left + 1});
+}
+
+void Rasterizer::addPixel(QPoint pixel) {
+    addSpan(pixel.y(), pixel.x(), pixel.x());
+}
+
+std::vector<int> Rasterizer::ellipseHalfWidths(int radiusX, int radiusY) {
+    // Measuring from half a pixel outside the radius gives round shapes with flat tops, like the midpoint circle
+    std::vector<int> halfWidths;
+    halfWidths.reserve(2 * radiusY + 1);
+    double outerX = radiusX + 0.5;
+    double outerY = radiusY + 0.5;
+    for (int dy = -radiusY; dy <= radiusY; dy++) {
+        double ratio = dy / outerY;
+        int halfWidth = int(std::floor(outerX * std::sqrt(std::max(0.0, 1 - ratio * ratio))));
+        halfWidths.push_back(std::min(halfWidth, radiusX));
+    }
+    return halfWidths;
+}
+
+void Rasterizer::normalize() {
+    if (isNormalized) {
+        return;
+    }
+
+    std::sort(spans.begin(), spans.end(), [](const Span& a, const Span& b) {
+        return a.y < b.y || (a.y == b.y && a.x < b.x);
+    });
+
+    std::vector<Span> merged;
+    merged.reserve(spans.size());
+    for (const Span& span : spans) {
+        if (!merged.empty() && merged.back().y == span.y && merged.back().x + merged.back().length >= span.x) {
+            Span& last = merged.back();
+            last.length = std::max(last.x + last.length, span.x + span.length) - last.x;
+        } else {
+            merged.push_back(span);
+        }
+    }
+    spans.swap(merged);
+    isNormalized = true;
+}
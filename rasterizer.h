@@ -0,0 +1,109 @@
+/*
+    Authors: Zhuyi Bu, Zhenzhi Liu, Justin Melore, Maxwell Rodgers, Duke Nguyen, Minh Khoa Ngo
+    Github usernames: 1144761429, 0doxes0, JustinMelore, maxdotr, duke7012, Mkhoa161
+    Date: November 21st, 2024
+    Class: CS3505, Fall 2024
+    Assignment - A8: Sprite Editor Implementation
+
+    The Rasterizer class turns the shapes of the shape tools into horizontal spans of pixels, clipped to a
+    rectangle (normally the frame). Filled shapes produce one span per row, outlines produce the runs of pixels
+    along their edges, so the cost follows the rows or the perimeter of a shape rather than its area. Shapes can
+    be combined, and getSpans sorts the spans by row and merges the ones that overlap or touch, so no pixel is
+    listed twice.
+*/
+
+#ifndef RASTERIZER_H
+#define RASTERIZER_H
+
+#include <QPoint>
+#include <QRect>
+#include <vector>
+
+class Rasterizer
+{
+public:
+    /// \brief A horizontal run of pixels.
+    struct Span {
+        int y;
+        int x;
+        int length;
+    };
+
+    /// \brief Constructor for the rasterizer.
+    /// \param clipRect Only pixels inside this rectangle are kept. A null rectangle keeps every pixel.
+    explicit Rasterizer(const QRect& clipRect = QRect());
+
+    /// \brief setClipRect Change the rectangle pixels are clipped to. Only affects shapes added afterwards.
+    /// \param newClipRect The new rectangle.
+    void setClipRect(const QRect& newClipRect);
+
+    /// \brief getClipRect Returns the rectangle pixels are clipped to, null if they are not clipped.
+    QRect getClipRect() const;
+
+    /// \brief line Add a line, including both end points.
+    void line(QPoint from, QPoint to);
+
+    /// \brief rect Add a rectangle.
+    /// \param rect The rectangle, including its right and bottom edges.
+    /// \param isFilled Whether to fill it or only add its outline.
+    void rect(const QRect& rect, bool isFilled);
+
+    /// \brief ellipse Add an axis-aligned ellipse.
+    /// \param center The center pixel.
+    /// \param radiusX The horizontal radius in pixels.
+    /// \param radiusY The vertical radius in pixels.
+    /// \param isFilled Whether to fill it or only add its outline.
+    void ellipse(QPoint center, int radiusX, int radiusY, bool isFilled);
+
+    /// \brief triangle Add a triangle.
+    /// \param isFilled Whether to fill it or only add its outline.
+    void triangle(QPoint a, QPoint b, QPoint c, bool isFilled);
+
+    /// \brief polygon Add a closed polygon. A filled polygon uses the even-odd rule, and always includes its
+    /// outline, so a thin polygon does not lose pixels.
+    /// \param vertices The corners, in order.
+    /// \param isFilled Whether to fill it or only add its outline.
+    void polygon(const std::vector<QPoint>& vertices, bool isFilled);
+
+    /// \brief addSpan Add the pixels from left to right on a row.
+    /// \param y The row.
+    /// \param left The first column.
+    /// \param right The last column.
+    void addSpan(int y, int left, int right);
+
+    /// \brief addPixel Add a single pixel.
+    void addPixel(QPoint pixel);
+
+    /// \brief getSpans Returns the spans sorted by row and column, with overlapping and touching spans merged.
+    const std::vector<Span>& getSpans();
+
+    /// \brief boundingRect Returns the smallest rectangle holding every span, or a null rectangle if empty.
+    QRect boundingRect();
+
+    /// \brief isEmpty Check if no pixel was added.
+    bool isEmpty() const;
+
+    /// \brief clear Forget every span, keeping the clip rectangle.
+    void clear();
+
+    /// \brief appendLine Append the pixels of a line to a list, without its first pixel, so consecutive
+    /// segments of a stroke do not repeat the points they share.
+    /// \param from The first pixel of the line.
+    /// \param to The last pixel of the line.
+    /// \param pixels The list to append to.
+    static void appendLine(QPoint from, QPoint to, std::vector<QPoint>& pixels);
+
+private:
+    QRect clipRect;
+    std::vector<Span> spans;
+    bool isNormalized = true;
+
+    /// \brief ellipseHalfWidths Returns, for every row from the top of an ellipse to its bottom, how far the
+    /// ellipse reaches left and right of its center.
+    static std::vector<int> ellipseHalfWidths(int radiusX, int radiusY);
+
+    /// \brief normalize Sort the spans and merge the ones that overlap or touch.
+    void normalize();
+};
+
+#endif // RASTERIZER_H
@@ -0,0 +1,171 @@
+/*
+    Authors: Zhuyi Bu, Zhenzhi Liu, Justin Melore, Maxwell Rodgers, Duke Nguyen, Minh Khoa Ngo
+    Github usernames: 1144761429, 0doxes0, JustinMelore, maxdotr, duke7012, Mkhoa161
+    Date: November 24th, 2024
+    Class: CS3505, Fall 2024
+    Assignment - A8: Sprite Editor Implementation
+
+    The cpp file for the Selection class.
+*/
+
+#include "selection.h"
+#include "frame.h"
+#include <QRegion>
+#include <cstring>
+
+bool Selection::isEmpty() const {
+    return mask.isNull();
+}
+
+void Selection::setRect(const QRect& newRect, int sideLength) {
+    Rasterizer raster(QRect(0, 0, sideLength, sideLength));
+    raster.rect(newRect, true);
+    setMask(raster);
+}
+
+void Selection::setLasso(const std::vector<QPoint>& points, int sideLength) {
+    Rasterizer raster(QRect(0, 0, sideLength, sideLength));
+    raster.polygon(points, true);
+    setMask(raster);
+}
+
+void Selection::setFloating(const QImage& newPixels, const QImage& newMask, QPoint position) {
+    rect = QRect(position, newMask.size());
+    mask = newMask;
+    pixels = newPixels;
+    updateOutline();
+}
+
+void Selection::clear() {
+    rect = QRect();
+    mask = QImage();
+    pixels = QImage();
+    outline = QPainterPath();
+}
+
+bool Selection::contains(QPoint pixel) const {
+    if (!rect.contains(pixel)) {
+        return false;
+    }
+    return mask.constScanLine(pixel.y() - rect.top())[pixel.x() - rect.left()] != 0;
+}
+
+QRect Selection::getRect() const {
+    return rect;
+}
+
+const QImage& Selection::getMask() const {
+    return mask;
+}
+
+const QPainterPath& Selection::getOutline() const {
+    return outline;
+}
+
+bool Selection::isFloating() const {
+    return !pixels.isNull();
+}
+
+const QImage& Selection::getPixels() const {
+    return pixels;
+}
+
+QImage Selection::copyPixels(const QImage& frameImage) const {
+    QImage copy(rect.size(), Frame::FORMAT);
+    copy.fill(0u);
+
+    QRect source = rect.intersected(frameImage.rect());
+    if (source.isEmpty()) {
+        return copy;
+    }
+
+    bool isIndexed = frameImage.format() == QImage::Format_Indexed8;
+    QList<QRgb> colorTable;
+    for (QRgb color : frameImage.colorTable()) {
+        colorTable.append(qPremultiply(color));
+    }
+
+    for (int y = source.top(); y <= source.bottom(); y++) {
+        const uchar* maskRow = mask.constScanLine(y - rect.top());
+        QRgb* out = reinterpret_cast<QRgb*>(copy.scanLine(y - rect.top()));
+        int offset = source.left() - rect.left();
+
+        if (isIndexed) {
+            const uchar* in = frameImage.constScanLine(y) + source.left();
+            for (int i = 0; i < source.width(); i++) {
+                if (maskRow[offset + i] != 0 && in[i] < colorTable.size()) {
+                    out[offset + i] = colorTable[in[i]];
+                }
+            }
+            continue;
+        }
+
+        // Copy the whole row, then clear what is outside the mask
+        const QRgb* in = reinterpret_cast<const QRgb*>(frameImage.constScanLine(y)) + source.left();
+        std::memcpy(out + offset, in, source.width() * sizeof(QRgb));
+        for (int i = 0; i < source.width(); i++) {
+            if (maskRow[offset + i] == 0) {
+                out[offset + i] = 0;
+            }
+        }
+    }
+    return copy;
+}
+
+void Selection::lift(const QImage& frameImage) {
+    if (isEmpty() || isFloating()) {
+        return;
+    }
+    pixels = copyPixels(frameImage);
+}
+
+void Selection::moveBy(QPoint offset) {
+    rect.translate(offset);
+}
+
+std::vector<Rasterizer::Span> Selection::getSpans() const {
+    std::vector<Rasterizer::Span> spans;
+    for (int y = 0; y < rect.height(); y++) {
+        const uchar* maskRow = mask.constScanLine(y);
+        int x = 0;
+        while (x < rect.width()) {
+            if (maskRow[x] == 0) {
+                x++;
+                continue;
+            }
+            int start = x;
+            while (x < rect.width() && maskRow[x] != 0) {
+                x++;
+            }
+            spans.push_back(Rasterizer::Span{rect.top() + y, rect.left() + start, x - start});
+        }
+    }
+    return spans;
+}
+
+void Selection::setMask(Rasterizer& raster) {
+    pixels = QImage();
+    rect = raster.boundingRect();
+    if (rect.isNull()) {
+        clear();
+        return;
+    }
+
+    mask = QImage(rect.size(), QImage::Format_Alpha8);
+    mask.fill(0);
+    for (const Rasterizer::Span& span : raster.getSpans()) {
+        std::memset(mask.scanLine(span.y - rect.top()) + span.x - rect.left(), 255, span.length);
+    }
+    updateOutline();
+}
+
+void Selection::updateOutline() {
+    // A region of the selected runs, merged into one path so only the border is drawn, not every run
+    QRegion region;
+    for (const Rasterizer::Span& span : getSpans()) {
+        region += QRect(span.x - rect.left(), span.y - rect.top(), span.length, 1);
+    }
+    QPainterPath path;
+    path.addRegion(region);
+    outline = path.simplified();
+}
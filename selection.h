@@ -0,0 +1,98 @@
+/*
+    Authors: Zhuyi Bu, Zhenzhi Liu, Justin Melore, Maxwell Rodgers, Duke Nguyen, Minh Khoa Ngo
+    Github usernames: 1144761429, 0doxes0, JustinMelore, maxdotr, duke7012, Mkhoa161
+    Date: November 24th, 2024
+    Class: CS3505, Fall 2024
+    Assignment - A8: Sprite Editor Implementation
+
+    The Selection class holds the part of a frame picked with the rectangle or lasso selection tools, as a byte
+    mask over its bounding rectangle. A selection can float: its pixels are then lifted off the frame into an
+    image of their own that is moved around on top of the frame, and only written back into the frame when the
+    selection is anchored. Moving a floating selection only changes its position, no pixel is copied.
+*/
+
+#ifndef SELECTION_H
+#define SELECTION_H
+
+#include "rasterizer.h"
+#include <QImage>
+#include <QPainterPath>
+#include <QPoint>
+#include <QRect>
+#include <vector>
+
+class Selection
+{
+public:
+    /// \brief isEmpty Check if nothing is selected.
+    bool isEmpty() const;
+
+    /// \brief setRect Select a rectangle, clipped to the frame. The selection does not float.
+    /// \param rect The rectangle in canvas pixels, including its right and bottom edges.
+    /// \param sideLength The side length of the frame.
+    void setRect(const QRect& rect, int sideLength);
+
+    /// \brief setLasso Select the inside of a closed lasso path, clipped to the frame. The selection does not
+    /// float.
+    /// \param points The path in canvas pixels, closed back to its first point.
+    /// \param sideLength The side length of the frame.
+    void setLasso(const std::vector<QPoint>& points, int sideLength);
+
+    /// \brief setFloating Make floating pixels the selection, e.g. when pasting.
+    /// \param newPixels The pixels, in Frame::FORMAT.
+    /// \param newMask Which pixels are selected, in Format_Alpha8 of the same size.
+    /// \param position Where the top left corner of the pixels is, in canvas pixels.
+    void setFloating(const QImage& newPixels, const QImage& newMask, QPoint position);
+
+    /// \brief clear Select nothing, dropping floating pixels.
+    void clear();
+
+    /// \brief contains Check if a pixel is selected, wherever the selection was moved to.
+    /// \param pixel The canvas pixel.
+    bool contains(QPoint pixel) const;
+
+    /// \brief getRect Returns the bounding rectangle of the selection where it currently is, in canvas pixels.
+    QRect getRect() const;
+
+    /// \brief getMask Returns the mask over getRect, in Format_Alpha8, non-zero where pixels are selected.
+    const QImage& getMask() const;
+
+    /// \brief getOutline Returns the border of the selected pixels, relative to the top left of getRect.
+    const QPainterPath& getOutline() const;
+
+    /// \brief isFloating Check if the selection holds pixels of its own.
+    bool isFloating() const;
+
+    /// \brief getPixels Returns the pixels of a floating selection over getRect, in Frame::FORMAT.
+    const QImage& getPixels() const;
+
+    /// \brief copyPixels Copy the pixels of a frame under the selection, a row at a time.
+    /// \param frameImage The pixels of the frame, in Frame::FORMAT or Format_Indexed8.
+    /// \return The pixels over getRect in Frame::FORMAT, transparent where nothing is selected.
+    QImage copyPixels(const QImage& frameImage) const;
+
+    /// \brief lift Make the selection float, holding a copy of the pixels of a frame under it.
+    /// \param frameImage The pixels of the frame, in Frame::FORMAT or Format_Indexed8.
+    void lift(const QImage& frameImage);
+
+    /// \brief moveBy Move the selection.
+    /// \param offset How far to move, in canvas pixels.
+    void moveBy(QPoint offset);
+
+    /// \brief getSpans Returns the selected pixels where the selection currently is, as spans.
+    std::vector<Rasterizer::Span> getSpans() const;
+
+private:
+    QRect rect;
+    QImage mask;
+    QImage pixels;
+    QPainterPath outline;
+
+    /// \brief setMask Select the pixels of a rasterizer, which must be clipped to the frame.
+    void setMask(Rasterizer& raster);
+
+    /// \brief updateOutline Trace the border of the mask again.
+    void updateOutline();
+};
+
+#endif // SELECTION_H
@@ -0,0 +1,192 @@
+/*
+    Authors: Zhuyi Bu, Zhenzhi Liu, Justin Melore, Maxwell Rodgers, Duke Nguyen, Minh Khoa Ngo
+    Github usernames: 1144761429, 0doxes0, JustinMelore, maxdotr, duke7012, Mkhoa161
+    Date: November 14th, 2024
+    Class: CS3505, Fall 2024
+    Assignment - A8: Sprite Editor Implementation
+
+    The cpp file for the SpriteFile class.
+*/
+
+#include "spritefile.h"
+#include <QDataStream>
+#include <QtEndian>
+#include <cstring>
+
+const char SpriteFile::MAGIC[4] = {'S', 'P', 'R', 'T'};
+
+bool SpriteFile::isBinary(const QByteArray& data) {
+    return data.size() >= HEADER_SIZE && std::memcmp(data.constData(), MAGIC, sizeof(MAGIC)) == 0;
+}
+
+QByteArray SpriteFile::write(int sideLength, const std::vector<EncodedFrame>& frames) {
+    QByteArray out;
+    QDataStream stream(&out, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    stream.writeRawData(MAGIC, sizeof(MAGIC));
+    stream << quint16(VERSION) << quint16(0) << quint32(sideLength) << quint32(frames.size());
+
+    // The blobs are laid out back to back right after the table
+    quint64 offset = HEADER_SIZE + quint64(TABLE_ENTRY_SIZE) * frames.size();
+    for (const EncodedFrame& frame : frames) {
+        stream << offset << quint32(frame.blob.size()) << frame.encoding << quint8(0) << quint8(0) << quint8(0);
+        offset += frame.blob.size();
+    }
+
+    for (const EncodedFrame& frame : frames) {
+        stream.writeRawData(frame.blob.constData(), frame.blob.size());
+    }
+
+    return out;
+}
+
+bool SpriteFile::readIndex(const QByteArray& data, int& sideLength, std::vector<FrameEntry>& entries) {
+    if (!isBinary(data)) {
+        return false;
+    }
+
+    QDataStream stream(data);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.skipRawData(sizeof(MAGIC));
+
+    quint16 version, flags;
+    quint32 side, frameCount;
+    stream >> version >> flags >> side >> frameCount;
+
+    // Version 3 only added links, so version 2 files read the same way
+    // Larger sides would overflow the size of a decoded frame
+    if (version < MIN_VERSION || version > VERSION || side == 0 || side > MAX_SIDE_LENGTH) {
+        return false;
+    }
+
+    if (quint64(data.size()) < HEADER_SIZE + quint64(TABLE_ENTRY_SIZE) * frameCount) {
+        return false;
+    }
+
+    entries.clear();
+    entries.reserve(frameCount);
+    for (quint32 i = 0; i < frameCount; i++) {
+        FrameEntry entry;
+        quint8 reserved;
+        stream >> entry.offset >> entry.size >> entry.encoding >> reserved >> reserved >> reserved;
+
+        // Written so that a huge offset cannot wrap the sum around and pass
+        if (entry.offset > quint64(data.size()) || entry.size > quint64(data.size()) - entry.offset) {
+            return false;
+        }
+        entries.push_back(entry);
+    }
+
+    sideLength = int(side);
+    return stream.status() == QDataStream::Ok;
+}
+
+SpriteFile::EncodedFrame SpriteFile::frameAt(const char* data, const FrameEntry& entry) {
+    EncodedFrame frame;
+    frame.blob = QByteArray::fromRawData(data + entry.offset, entry.size);
+    frame.encoding = entry.encoding;
+    return frame;
+}
+
+SpriteFile::EncodedFrame SpriteFile::encodeImage(const QImage& image) {
+    QImage argb = image.convertToFormat(QImage::Format_ARGB32);
+    int rowBytes = argb.width() * 4;
+
+    QByteArray raw(rowBytes * argb.height(), Qt::Uninitialized);
+    for (int y = 0; y < argb.height(); y++) {
+        std::memcpy(raw.data() + y * rowBytes, argb.constScanLine(y), rowBytes);
+    }
+
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    qToLittleEndian<quint32>(raw.constData(), raw.size() / 4, raw.data());
+#endif
+
+    EncodedFrame frame;
+    QByteArray packed = qCompress(raw, COMPRESSION_LEVEL);
+    if (packed.size() < raw.size()) {
+        frame.blob = packed;
+        frame.encoding = ZLIB;
+    } else {
+        frame.blob = raw;
+        frame.encoding = RAW;
+    }
+    return frame;
+}
+
+SpriteFile::EncodedFrame SpriteFile::encodeIndices(const QImage& indices) {
+    int rowBytes = indices.width();
+    QByteArray raw(rowBytes * indices.height(), Qt::Uninitialized);
+    for (int y = 0; y < indices.height(); y++) {
+        std::memcpy(raw.data() + y * rowBytes, indices.constScanLine(y), rowBytes);
+    }
+
+    EncodedFrame frame;
+    frame.blob = qCompress(raw, COMPRESSION_LEVEL);
+    frame.encoding = INDEXED;
+    return frame;
+}
+
+QImage SpriteFile::decodeIndices(const EncodedFrame& frame, int sideLength) {
+    if (frame.encoding != INDEXED) {
+        return QImage();
+    }
+
+    QByteArray raw = qUncompress(frame.blob);
+    if (raw.size() != sideLength * sideLength) {
+        return QImage();
+    }
+
+    QImage indices(sideLength, sideLength, QImage::Format_Indexed8);
+    for (int y = 0; y < sideLength; y++) {
+        std::memcpy(indices.scanLine(y), raw.constData() + y * sideLength, sideLength);
+    }
+    return indices;
+}
+
+SpriteFile::EncodedFrame SpriteFile::linkTo(int frameIndex) {
+    EncodedFrame frame;
+    frame.blob.resize(sizeof(quint32));
+    qToLittleEndian<quint32>(frameIndex, frame.blob.data());
+    frame.encoding = LINK;
+    return frame;
+}
+
+int SpriteFile::linkedFrame(const EncodedFrame& frame) {
+    if (frame.encoding != LINK || frame.blob.size() != sizeof(quint32)) {
+        return -1;
+    }
+    return int(qFromLittleEndian<quint32>(frame.blob.constData()));
+}
+
+QImage SpriteFile::decodeImage(const EncodedFrame& frame, int sideLength) {
+    QByteArray raw;
+    switch (frame.encoding) {
+        case RAW:
+            raw = frame.blob;
+            break;
+        case ZLIB:
+            raw = qUncompress(frame.blob);
+            break;
+        default:
+            return QImage();
+    }
+
+    int rowBytes = sideLength * 4;
+    if (raw.size() != rowBytes * sideLength) {
+        return QImage();
+    }
+
+    QImage image(sideLength, sideLength, QImage::Format_ARGB32);
+    for (int y = 0; y < sideLength; y++) {
+        std::memcpy(image.scanLine(y), raw.constData() + y * rowBytes, rowBytes);
+    }
+
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    for (int y = 0; y < sideLength; y++) {
+        qFromLittleEndian<quint32>(image.constScanLine(y), sideLength, image.scanLine(y));
+    }
+#endif
+
+    return image;
+}
@@ -0,0 +1,125 @@
+/*
+    Authors: Zhuyi Bu, Zhenzhi Liu, Justin Melore, Maxwell Rodgers, Duke Nguyen, Minh Khoa Ngo
+    Github usernames: 1144761429, 0doxes0, JustinMelore, maxdotr, duke7012, Mkhoa161
+    Date: November 14th, 2024
+    Class: CS3505, Fall 2024
+    Assignment - A8: Sprite Editor Implementation
+
+    The SpriteFile class reads and writes the binary .sprite container. A file starts with a fixed header
+    (magic number, version, side length, frame count) followed by a frame table that records where every
+    frame's pixel data lives, so the pixel blobs that follow can be located without scanning the file.
+    Each frame stores its ARGB32 rows either raw or packed with qCompress, whichever is smaller. A linked frame,
+    which shares its pixels with an earlier frame, only stores the index of that frame.
+
+    Layout (all integers little-endian):
+        header      "SPRT" | quint16 version | quint16 flags | quint32 sideLength | quint32 frameCount
+        frame table frameCount x (quint64 offset | quint32 size | quint8 encoding | 3 reserved bytes)
+        frame data  one blob per frame, located by the table
+*/
+
+#ifndef SPRITEFILE_H
+#define SPRITEFILE_H
+
+#include <QByteArray>
+#include <QImage>
+#include <vector>
+
+class SpriteFile
+{
+public:
+    /// \brief How the pixel rows of a frame are stored inside its blob.
+    enum Encoding : quint8 {
+        RAW = 0,
+        ZLIB = 1,
+        /// The blob holds the quint32 index of an earlier frame whose pixels this frame shares.
+        LINK = 2,
+        /// The blob holds the qCompress-packed palette indices of an indexed frame, one byte per pixel. Only the
+        /// autosave journal writes it, since it needs the palette that is journaled alongside.
+        INDEXED = 3
+    };
+
+    /// \brief A frame table entry, describing where a frame's blob lives in the file.
+    struct FrameEntry {
+        quint64 offset;
+        quint32 size;
+        quint8 encoding;
+    };
+
+    /// \brief The packed pixels of one frame together with the encoding needed to unpack them.
+    struct EncodedFrame {
+        QByteArray blob;
+        quint8 encoding = RAW;
+    };
+
+    static const quint16 VERSION = 3;
+    static const quint16 MIN_VERSION = 2;
+    static const int HEADER_SIZE = 16;
+    static const int TABLE_ENTRY_SIZE = 16;
+
+    /// \brief MAX_SIDE_LENGTH The largest side length the editor supports, the limit of the canvas size dialog.
+    static const quint32 MAX_SIDE_LENGTH = 4096;
+
+    /// \brief isBinary Check if the data starts with the magic number of the binary format.
+    /// \param data The contents of a .sprite file.
+    /// \return True for the binary format, false for anything else (e.g. the legacy JSON format).
+    static bool isBinary(const QByteArray& data);
+
+    /// \brief write Serialize a whole project into the binary format.
+    /// \param sideLength The side length of every frame.
+    /// \param frames The encoded pixels of every frame, in frame order.
+    /// \return The bytes of the file.
+    static QByteArray write(int sideLength, const std::vector<EncodedFrame>& frames);
+
+    /// \brief readIndex Parse only the header and frame table, without touching any pixel data.
+    /// \param data The bytes of the file.
+    /// \param sideLength Receives the side length of the project.
+    /// \param entries Receives the frame table.
+    /// \return False if the header or the table is malformed.
+    static bool readIndex(const QByteArray& data, int& sideLength, std::vector<FrameEntry>& entries);
+
+    /// \brief frameAt Reference the blob of a frame inside the file data without copying it.
+    /// The returned blob is only valid for as long as the file data is.
+    /// \param data The bytes of the file.
+    /// \param entry The frame's entry in the frame table.
+    /// \return The encoded frame.
+    static EncodedFrame frameAt(const char* data, const FrameEntry& entry);
+
+    /// \brief encodeImage Pack the pixels of one frame into a blob.
+    /// \param image The frame's pixels.
+    /// \return The blob and the encoding that was picked for it.
+    static EncodedFrame encodeImage(const QImage& image);
+
+    /// \brief encodeIndices Pack the palette indices of an indexed frame into an INDEXED blob.
+    /// \param indices The frame's pixels, in Format_Indexed8.
+    /// \return The blob and its encoding.
+    static EncodedFrame encodeIndices(const QImage& indices);
+
+    /// \brief decodeIndices Unpack an INDEXED blob back into palette indices.
+    /// \param frame The blob and its encoding, as returned by encodeIndices.
+    /// \param sideLength The side length of the frame.
+    /// \return The frame's indices in Format_Indexed8 without a color table, or a null QImage if the blob is
+    /// corrupt or not INDEXED.
+    static QImage decodeIndices(const EncodedFrame& frame, int sideLength);
+
+    /// \brief linkTo Make the entry of a frame that shares the pixels of an earlier frame.
+    /// \param frameIndex The index of the earlier frame.
+    /// \return The encoded frame.
+    static EncodedFrame linkTo(int frameIndex);
+
+    /// \brief linkedFrame Get the frame a linked frame shares its pixels with.
+    /// \param frame The encoded frame.
+    /// \return The index of the earlier frame, or -1 if the frame is not a link.
+    static int linkedFrame(const EncodedFrame& frame);
+
+    /// \brief decodeImage Unpack one frame blob back into pixels.
+    /// \param frame The blob and its encoding, as returned by encodeImage.
+    /// \param sideLength The side length of the frame.
+    /// \return The frame's pixels, or a null QImage if the blob is corrupt.
+    static QImage decodeImage(const EncodedFrame& frame, int sideLength);
+
+private:
+    static const char MAGIC[4];
+    static const int COMPRESSION_LEVEL = 1;
+};
+
+#endif // SPRITEFILE_H
@@ -0,0 +1,237 @@
+/*
+    Authors: Zhuyi Bu, Zhenzhi Liu, Justin Melore, Maxwell Rodgers, Duke Nguyen, Minh Khoa Ngo
+    Github usernames: 1144761429, 0doxes0, JustinMelore, maxdotr, duke7012, Mkhoa161
+    Date: November 22nd, 2024
+    Class: CS3505, Fall 2024
+    Assignment - A8: Sprite Editor Implementation
+
+    The cpp file for the Symmetry class.
+*/
+
+#include "symmetry.h"
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+
+Symmetry::Symmetry() {
+    updateTransforms();
+}
+
+void Symmetry::setSideLength(int sideLength) {
+    center = QPointF(sideLength / 2.0, sideLength / 2.0);
+}
+
+void Symmetry::setCenter(QPointF newCenter) {
+    center = QPointF(std::round(newCenter.x() * 2) / 2, std::round(newCenter.y() * 2) / 2);
+}
+
+QPointF Symmetry::getCenter() const {
+    return center;
+}
+
+void Symmetry::setMirroredLeftRight(bool enabled) {
+    isLeftRight = enabled;
+    updateTransforms();
+}
+
+bool Symmetry::isMirroredLeftRight() const {
+    return isLeftRight;
+}
+
+void Symmetry::setMirroredTopBottom(bool enabled) {
+    isTopBottom = enabled;
+    updateTransforms();
+}
+
+bool Symmetry::isMirroredTopBottom() const {
+    return isTopBottom;
+}
+
+void Symmetry::setRotations(int count) {
+    rotations = count < 1 ? 1 : (count > MAX_ROTATIONS ? MAX_ROTATIONS : count);
+    updateTransforms();
+}
+
+int Symmetry::getRotations() const {
+    return rotations;
+}
+
+bool Symmetry::isEnabled() const {
+    return transforms.size() > 1;
+}
+
+void Symmetry::apply(Rasterizer& source, Rasterizer& target) const {
+    const std::vector<Rasterizer::Span>& spans = source.getSpans();
+    for (const Transform& transform : transforms) {
+        if (transform.xy == 0 && transform.yx == 0) {
+            // Mirrors across the axes keep rows as rows, so a span maps to a span through its two ends
+            for (const Rasterizer::Span& span : spans) {
+                QPoint first = map(transform, QPoint(span.x, span.y));
+                QPoint last = map(transform, QPoint(span.x + span.length - 1, span.y));
+                target.addSpan(first.y(), std::min(first.x(), last.x()), std::max(first.x(), last.x()));
+            }
+        } else if (transform.xx == 0 && transform.yy == 0) {
+            // Quarter turns map a span exactly onto a column
+            for (const Rasterizer::Span& span : spans) {
+                target.line(map(transform, QPoint(span.x, span.y)),
+                            map(transform, QPoint(span.x + span.length - 1, span.y)));
+            }
+        } else {
+            fillTurned(transform, spans, source.boundingRect(), target);
+        }
+    }
+}
+
+void Symmetry::fillTurned(const Transform& transform, const std::vector<Rasterizer::Span>& spans, const QRect& bounds,
+                          Rasterizer& target) const {
+    // Every transform is a rotation or a mirror, so its transpose undoes it
+    Transform inverse{transform.xx, transform.yx, transform.xy, transform.yy};
+
+    // Only the source pixels whose copies can land inside the clip rectangle of the target matter
+    QRect clipRect = target.getClipRect();
+    QRect window = clipRect.isNull() ? bounds : bounds.intersected(turnedBounds(inverse, clipRect));
+    if (window.isEmpty()) {
+        return;
+    }
+    std::vector<uchar> coverage(size_t(window.width()) * window.height(), 0);
+    for (const Rasterizer::Span& span : spans) {
+        int left = std::max(span.x, window.left());
+        int right = std::min(span.x + span.length - 1, window.right());
+        if (span.y >= window.top() && span.y <= window.bottom() && left <= right) {
+            std::fill_n(coverage.begin() + size_t(span.y - window.top()) * window.width() + (left - window.left()),
+                        right - left + 1, uchar(1));
+        }
+    }
+
+    QRect copyRect = turnedBounds(transform, window);
+    if (!clipRect.isNull()) {
+        copyRect = copyRect.intersected(clipRect);
+    }
+
+    // A pixel of the copy is painted when its center maps back into a painted pixel, so the copy is filled
+    // without the pinholes that turning each pixel forward would leave
+    for (int y = copyRect.top(); y <= copyRect.bottom(); y++) {
+        double dx = copyRect.left() + 0.5 - center.x();
+        double dy = y + 0.5 - center.y();
+        double sourceX = center.x() + inverse.xx * dx + inverse.xy * dy - window.left();
+        double sourceY = center.y() + inverse.yx * dx + inverse.yy * dy - window.top();
+
+        int runStart = -1;
+        for (int x = copyRect.left(); x <= copyRect.right() + 1; x++) {
+            int column = int(std::floor(sourceX));
+            int row = int(std::floor(sourceY));
+            bool isPainted = x <= copyRect.right() && column >= 0 && row >= 0 && column < window.width()
+                          && row < window.height() && coverage[size_t(row) * window.width() + column] != 0;
+            if (isPainted && runStart < 0) {
+                runStart = x;
+            } else if (!isPainted && runStart >= 0) {
+                target.addSpan(y, runStart, x - 1);
+                runStart = -1;
+            }
+            sourceX += inverse.xx;
+            sourceY += inverse.yx;
+        }
+    }
+}
+
+QRect Symmetry::turnedBounds(const Transform& transform, const QRect& rect) const {
+    // The pixels covering the turned corners of the rectangle
+    const QPointF corners[] = {QPointF(rect.left(), rect.top()), QPointF(rect.right() + 1, rect.top()),
+                               QPointF(rect.left(), rect.bottom() + 1), QPointF(rect.right() + 1, rect.bottom() + 1)};
+    double left = 0, right = 0, top = 0, bottom = 0;
+    for (int i = 0; i < 4; i++) {
+        double dx = corners[i].x() - center.x();
+        double dy = corners[i].y() - center.y();
+        double x = center.x() + transform.xx * dx + transform.xy * dy;
+        double y = center.y() + transform.yx * dx + transform.yy * dy;
+        left = i == 0 ? x : std::min(left, x);
+        right = i == 0 ? x : std::max(right, x);
+        top = i == 0 ? y : std::min(top, y);
+        bottom = i == 0 ? y : std::max(bottom, y);
+    }
+    return QRect(QPoint(int(std::floor(left)), int(std::floor(top))),
+                 QPoint(int(std::floor(right)), int(std::floor(bottom))));
+}
+
+void Symmetry::applyPath(const std::vector<QPoint>& path, Rasterizer& target) const {
+    if (path.empty()) {
+        return;
+    }
+
+    // Turns that are not quarter turns can pull neighbouring pixels apart, so the copies are joined up again
+    for (const Transform& transform : transforms) {
+        QPoint previous = map(transform, path.front());
+        target.addPixel(previous);
+        for (size_t i = 1; i < path.size(); i++) {
+            QPoint next = map(transform, path[i]);
+            target.line(previous, next);
+            previous = next;
+        }
+    }
+}
+
+std::vector<QPoint> Symmetry::images(QPoint pixel) const {
+    std::vector<QPoint> pixels;
+    for (const Transform& transform : transforms) {
+        QPoint image = map(transform, pixel);
+        if (std::find(pixels.begin(), pixels.end(), image) == pixels.end()) {
+            pixels.push_back(image);
+        }
+    }
+    return pixels;
+}
+
+void Symmetry::updateTransforms() {
+    // Entries this close to -1, 0 or 1 are snapped to them, so quarter turns map pixels exactly
+    auto snap = [](double value) {
+        double rounded = std::round(value);
+        return std::abs(value - rounded) < 1e-9 ? rounded : value;
+    };
+
+    double angle = qDegreesToRadians(360.0 / rotations);
+    std::vector<Transform> generators;
+    generators.push_back(Transform{snap(std::cos(angle)), snap(-std::sin(angle)),
+                                   snap(std::sin(angle)), snap(std::cos(angle))});
+    if (isLeftRight) {
+        generators.push_back(Transform{-1, 0, 0, 1});
+    }
+    if (isTopBottom) {
+        generators.push_back(Transform{1, 0, 0, -1});
+    }
+
+    // The group the generators span: keep composing until no new transform shows up
+    transforms.clear();
+    transforms.push_back(Transform{1, 0, 0, 1});
+    for (size_t i = 0; i < transforms.size(); i++) {
+        for (const Transform& generator : generators) {
+            Transform next = compose(transforms[i], generator);
+            next = Transform{snap(next.xx), snap(next.xy), snap(next.yx), snap(next.yy)};
+
+            bool isNew = std::none_of(transforms.begin(), transforms.end(), [&](const Transform& known) {
+                return isSame(known, next);
+            });
+            if (isNew) {
+                transforms.push_back(next);
+            }
+        }
+    }
+}
+
+QPoint Symmetry::map(const Transform& transform, QPoint pixel) const {
+    // Pixel centers are mapped, so a copy lands on the pixel its center falls into
+    double dx = pixel.x() + 0.5 - center.x();
+    double dy = pixel.y() + 0.5 - center.y();
+    return QPoint(int(std::floor(center.x() + transform.xx * dx + transform.xy * dy)),
+                  int(std::floor(center.y() + transform.yx * dx + transform.yy * dy)));
+}
+
+Symmetry::Transform Symmetry::compose(const Transform& first, const Transform& second) {
+    return Transform{second.xx * first.xx + second.xy * first.yx, second.xx * first.xy + second.xy * first.yy,
+                     second.yx * first.xx + second.yy * first.yx, second.yx * first.xy + second.yy * first.yy};
+}
+
+bool Symmetry::isSame(const Transform& a, const Transform& b) {
+    const double epsilon = 1e-6;
+    return std::abs(a.xx - b.xx) < epsilon && std::abs(a.xy - b.xy) < epsilon
+        && std::abs(a.yx - b.yx) < epsilon && std::abs(a.yy - b.yy) < epsilon;
+}
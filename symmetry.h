@@ -0,0 +1,122 @@
+/*
+    Authors: Zhuyi Bu, Zhenzhi Liu, Justin Melore, Maxwell Rodgers, Duke Nguyen, Minh Khoa Ngo
+    Github usernames: 1144761429, 0doxes0, JustinMelore, maxdotr, duke7012, Mkhoa161
+    Date: November 22nd, 2024
+    Class: CS3505, Fall 2024
+    Assignment - A8: Sprite Editor Implementation
+
+    The Symmetry class replicates what a tool paints across the symmetry the user picked: a mirror axis from left
+    to right, one from top to bottom, and N-fold rotation, all around a common center. Every combination of those
+    makes a small set of transforms, which is worked out once whenever the settings change. Mirrors and quarter
+    turns map pixels onto pixels exactly, and mirrors across the axes even map whole spans onto spans, so those
+    cost about as much as painting without symmetry. Other angles round each copy to the nearest pixels.
+*/
+
+#ifndef SYMMETRY_H
+#define SYMMETRY_H
+
+#include "rasterizer.h"
+#include <QPoint>
+#include <QPointF>
+#include <QRect>
+#include <vector>
+
+class Symmetry
+{
+public:
+    static const int MAX_ROTATIONS = 12;
+
+    /// \brief Constructor for the symmetry, which starts out doing nothing.
+    Symmetry();
+
+    /// \brief setSideLength Size the symmetry for a frame, moving the center to the middle of the frame.
+    /// \param sideLength The side length of the frame.
+    void setSideLength(int sideLength);
+
+    /// \brief setCenter Move the point the mirror axes cross and the rotations turn around.
+    /// \param newCenter The point in canvas pixels, where the corners of pixels are at whole numbers. Rounded to
+    /// the nearest half pixel, so the center is always on the corner, the edge or the middle of a pixel.
+    void setCenter(QPointF newCenter);
+
+    /// \brief getCenter Returns the point the mirror axes cross and the rotations turn around.
+    QPointF getCenter() const;
+
+    /// \brief setMirroredLeftRight Set whether to mirror across the vertical axis through the center.
+    void setMirroredLeftRight(bool enabled);
+
+    /// \brief isMirroredLeftRight Check if mirroring across the vertical axis through the center.
+    bool isMirroredLeftRight() const;
+
+    /// \brief setMirroredTopBottom Set whether to mirror across the horizontal axis through the center.
+    void setMirroredTopBottom(bool enabled);
+
+    /// \brief isMirroredTopBottom Check if mirroring across the horizontal axis through the center.
+    bool isMirroredTopBottom() const;
+
+    /// \brief setRotations Set how many evenly turned copies to paint around the center.
+    /// \param count From 1, for no rotation, to MAX_ROTATIONS.
+    void setRotations(int count);
+
+    /// \brief getRotations Returns how many evenly turned copies are painted around the center.
+    int getRotations() const;
+
+    /// \brief isEnabled Check if anything is replicated at all.
+    bool isEnabled() const;
+
+    /// \brief apply Add every symmetric copy of a set of spans, including the spans themselves, to a rasterizer.
+    /// The target clips and merges the copies, so pixels where copies overlap are only painted once.
+    /// \param source The spans as painted by a tool, unclipped, so copies of pixels outside the frame can still
+    /// land inside it.
+    /// \param target Receives the copies.
+    void apply(Rasterizer& source, Rasterizer& target) const;
+
+    /// \brief applyPath Add every symmetric copy of a connected path of pixels, such as a brush stroke, to a
+    /// rasterizer. The copies stay connected at any angle.
+    /// \param path The pixels in the order they were painted, each touching the one before it.
+    /// \param target Receives the copies.
+    void applyPath(const std::vector<QPoint>& path, Rasterizer& target) const;
+
+    /// \brief images Returns a pixel and each of its symmetric copies, without duplicates.
+    /// \param pixel The canvas pixel.
+    std::vector<QPoint> images(QPoint pixel) const;
+
+private:
+    /// \brief A linear map around the center, from the offset of a pixel center to the offset of its copy.
+    struct Transform {
+        double xx, xy;
+        double yx, yy;
+    };
+
+    QPointF center;
+    bool isLeftRight = false;
+    bool isTopBottom = false;
+    int rotations = 1;
+
+    // Every distinct transform the settings combine into, the identity first
+    std::vector<Transform> transforms;
+
+    /// \brief updateTransforms Work out the transforms again after the settings changed.
+    void updateTransforms();
+
+    /// \brief fillTurned Add the copy of a set of spans under a turn that is not a quarter turn, filled row by row.
+    /// \param transform The turn, possibly combined with a mirror.
+    /// \param spans The spans.
+    /// \param bounds The bounding rectangle of the spans.
+    /// \param target Receives the copy.
+    void fillTurned(const Transform& transform, const std::vector<Rasterizer::Span>& spans, const QRect& bounds,
+                    Rasterizer& target) const;
+
+    /// \brief turnedBounds Returns the pixels covering a rectangle of pixels turned around the center.
+    QRect turnedBounds(const Transform& transform, const QRect& rect) const;
+
+    /// \brief map Returns the copy of a pixel under a transform.
+    QPoint map(const Transform& transform, QPoint pixel) const;
+
+    /// \brief compose Returns the transform that applies second after first.
+    static Transform compose(const Transform& first, const Transform& second);
+
+    /// \brief isSame Check if two transforms are the same, up to rounding.
+    static bool isSame(const Transform& a, const Transform& b);
+};
+
+#endif // SYMMETRY_H